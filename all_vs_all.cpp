@@ -0,0 +1,130 @@
+#include "all_vs_all.h"
+
+#include <TROOT.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+#include "parallel.h"
+#include "tree_cache.h"
+
+using namespace std::chrono;
+
+int run_all_vs_all_job(const Job_config& config, tree_cache* cache) {
+  high_resolution_clock::time_point t1 = high_resolution_clock::now();
+
+  std::vector<Tree_config> hypos = {config.primary};
+  hypos.insert(hypos.end(), config.alt_hypos.begin(), config.alt_hypos.end());
+  size_t n = hypos.size();
+
+  std::string out_base = config.out_file;
+  if (out_base == "placeholder" || out_base == "") {
+    out_base = std::to_string(n) + "_allVsAll";
+  }
+  if (out_base.size() > 5 &&
+      out_base.compare(out_base.size() - 5, 5, ".root") == 0) {
+    out_base.erase(out_base.size() - 5);
+  }
+
+  ROOT::EnableThreadSafety();
+
+  // load and reduce every tree exactly once
+  std::cout << "Pre-processing " << n << " hypotheses..." << std::endl;
+  std::vector<std::shared_ptr<hypothesis_tree_base>> trees;
+  for (const Tree_config& hypo : hypos) {
+    trees.push_back(cache ? cache->get(hypo.filename, hypo.treename,
+                                       config.best_by_beam)
+                          : make_hypothesis_tree(hypo.filename, hypo.treename,
+                                                 config.best_by_beam));
+    trees.back()->set_io(config.io);
+    trees.back()->set_perf_counters(config.perf_counters);
+  }
+  parallel_for(n, config.threads, [&trees](size_t i) { trees[i]->prepare(); });
+
+  // one comparison per hypothesis as primary, all sharing the same trees
+  std::vector<std::unique_ptr<compare_hypotheses>> comparisons;
+  for (size_t i = 0; i < n; i++) {
+    std::vector<std::shared_ptr<hypothesis_tree_base>> others;
+    for (size_t j = 0; j < n; j++) {
+      if (j != i) {
+        others.push_back(trees[j]);
+      }
+    }
+    comparisons.emplace_back(
+        new compare_hypotheses(trees[i], others, config.best_by_beam));
+    apply_options(*comparisons.back(), config);
+    // parallelism comes from running the hypotheses side by side
+    comparisons.back()->set_threads(1);
+  }
+
+  std::cout << "Data prepared, finding matches..." << std::endl;
+  parallel_for(n, config.threads, [&comparisons](size_t i) {
+    comparisons[i]->prepare_data();
+    comparisons[i]->find_matches();
+  });
+
+  high_resolution_clock::time_point t2 = high_resolution_clock::now();
+  auto matching_duration = duration_cast<microseconds>(t2 - t1).count();
+  std::cout << "The matching process took: " << matching_duration * 1E-6
+            << " seconds\n";
+
+  // matrix[i][j]: reduced combos of hypothesis i with a match in hypothesis j
+  std::vector<std::vector<size_t>> matrix(n, std::vector<size_t>(n, 0));
+  for (size_t i = 0; i < n; i++) {
+    const compare_hypotheses& c = *comparisons[i];
+    matrix[i][i] = config.best_by_beam
+                       ? c.primary_tree().event_beam_as_key_map.size()
+                       : c.primary_tree().event_as_key_map.size();
+    for (size_t k = 0, j = 0; j < n; j++) {
+      if (j == i) {
+        continue;
+      }
+      matrix[i][j] = config.best_by_beam ? c.matched_chi_sqs_by_beam[k].size()
+                                         : c.matched_chi_sqs[k].size();
+      k++;
+    }
+  }
+
+  std::string matrix_file = out_base + "_match_matrix.txt";
+  std::ofstream os(matrix_file);
+  if (!os.good()) {
+    std::cerr << "Error: Could not open " << matrix_file << '\n';
+    return 1;
+  }
+  os << "# rows: primary hypothesis; columns: matched hypothesis; diagonal: "
+        "reduced combos of the row's hypothesis\n";
+  os << std::setw(24) << "";
+  for (const Tree_config& hypo : hypos) {
+    os << ' ' << std::setw(24) << hypo.treename;
+  }
+  os << '\n';
+  for (size_t i = 0; i < n; i++) {
+    os << std::setw(24) << hypos[i].treename;
+    for (size_t j = 0; j < n; j++) {
+      os << ' ' << std::setw(24) << matrix[i][j];
+    }
+    os << '\n';
+  }
+  os.close();
+  std::cout << "Match count matrix written to " << matrix_file << '\n';
+
+  std::cout << "Writing to file...\n";
+  std::vector<char> written(n, false);
+  parallel_for(n, config.threads, [&](size_t i) {
+    written[i] = comparisons[i]->write_to_file(out_base + "_" +
+                                               hypos[i].treename + ".root");
+  });
+
+  high_resolution_clock::time_point t3 = high_resolution_clock::now();
+  auto write_duration = duration_cast<microseconds>(t3 - t2).count();
+  std::cout << "The file-writing process took: " << write_duration * 1E-6
+            << " seconds\n";
+  if (std::count(written.begin(), written.end(), false) > 0) {
+    std::cerr << "Error: Not every output was written.\n";
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,12 @@
+#ifndef ALL_VS_ALL_H
+#define ALL_VS_ALL_H
+
+#include "job.h"
+
+// all-pairs mode: every configured hypothesis is compared against all the
+// others. each tree is loaded and reduced once, matching runs for every
+// ordered pair from the shared indexes, and one augmented output is written
+// per hypothesis plus a matrix of match counts.
+int run_all_vs_all_job(const Job_config& config, tree_cache* cache = nullptr);
+
+#endif
@@ -0,0 +1,153 @@
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "compare_hypotheses.h"
+#include "input_files.h"
+
+// runs the prepare/match/write phases on the synthetic trees in both matching
+// modes and records each phase's throughput in entries per second
+
+using namespace std::chrono;
+
+namespace {
+
+struct Phase_result {
+  std::string name;
+  double entries;
+  double seconds;
+};
+
+double time_phase(const std::function<void()>& phase) {
+  steady_clock::time_point start = steady_clock::now();
+  phase();
+  return duration_cast<microseconds>(steady_clock::now() - start).count() *
+         1E-6;
+}
+
+void run_mode(const std::string& dir, bool match_by_beam,
+              std::vector<Phase_result>& results) {
+  std::string mode = match_by_beam ? "best_per_beam" : "best_combo";
+  std::vector<Tree_config> alts = {
+      {dir + "/tree_bench_alt.root", "bench_alt"}};
+  compare_hypotheses c(dir + "/tree_bench_primary.root", "bench_primary", alts,
+                       match_by_beam);
+  c.set_match_by_beam(match_by_beam);
+
+  double prepare = time_phase([&c]() { c.prepare_data(); });
+  double match = time_phase([&c]() { c.find_matches(); });
+  double write = time_phase(
+      [&c, &dir, &mode]() { c.write_to_file(dir + "/out_" + mode + ".root"); });
+
+  double primary_entries = c.primary_tree().event_column_data.size();
+  double alt_entries = c.alt_tree(0).event_column_data.size();
+  double reduced = match_by_beam
+                       ? c.primary_tree().event_beam_as_key_map.size()
+                       : c.primary_tree().event_as_key_map.size();
+  results.push_back({mode + "_prepare", primary_entries + alt_entries, prepare});
+  results.push_back({mode + "_match", reduced, match});
+  results.push_back({mode + "_write", primary_entries, write});
+}
+
+// the same phases against all alternatives at once, so the per-hypothesis
+// match loops and output branches are exercised
+void run_multi_hypothesis(const std::string& dir,
+                          std::vector<Phase_result>& results) {
+  std::vector<Tree_config> alts = {
+      {dir + "/tree_bench_alt.root", "bench_alt"},
+      {dir + "/tree_bench_alt2.root", "bench_alt2"},
+      {dir + "/tree_bench_alt3.root", "bench_alt3"},
+      {dir + "/tree_bench_alt4.root", "bench_alt4"}};
+  compare_hypotheses c(dir + "/tree_bench_primary.root", "bench_primary", alts,
+                       false);
+
+  double prepare = time_phase([&c]() { c.prepare_data(); });
+  double match = time_phase([&c]() { c.find_matches(); });
+  double write = time_phase(
+      [&c, &dir]() { c.write_to_file(dir + "/out_multi_hypothesis.root"); });
+
+  // prepare loads every tree but only reduces the primary; the alternatives
+  // are reduced (or streamed through the primary's index) while matching
+  double entries = c.primary_tree().event_column_data.size();
+  double alt_entries = 0;
+  for (size_t i = 0; i < alts.size(); i++) {
+    alt_entries += c.alt_tree(i).event_column_data.size();
+  }
+  results.push_back({"multi_hypothesis_prepare", entries + alt_entries,
+                     prepare});
+  results.push_back({"multi_hypothesis_match", alt_entries, match});
+  results.push_back({"multi_hypothesis_write",
+                     double(c.primary_tree().event_column_data.size()), write});
+}
+
+// writes the same matches with each output backend and compares write time
+// and file size against the default Snapshot TTree
+void compare_formats(const std::string& dir,
+                     std::vector<Phase_result>& results) {
+  std::vector<Tree_config> alts = {
+      {dir + "/tree_bench_alt.root", "bench_alt"}};
+  compare_hypotheses c(dir + "/tree_bench_primary.root", "bench_primary", alts,
+                       false);
+  c.prepare_data();
+  c.find_matches();
+  double entries = c.primary_tree().event_column_data.size();
+
+  struct Format {
+    std::string name;
+    bool compiled;
+    bool rntuple;
+    bool compact;
+  };
+  std::vector<Format> formats = {{"snapshot_tree", false, false, false},
+                                 {"compiled_tree", true, false, false},
+                                 {"compact_tree", true, false, true}};
+#ifdef CH_WITH_RNTUPLE
+  formats.push_back({"rntuple", false, true, false});
+#endif
+
+  for (const Format& format : formats) {
+    std::string out_file = dir + "/out_" + format.name + ".root";
+    c.set_compiled_output(format.compiled);
+    c.set_rntuple_output(format.rntuple);
+    Output_encoding encoding;
+    encoding.compact = format.compact;
+    c.set_encoding(encoding);
+    double write = time_phase([&c, &out_file]() { c.write_to_file(out_file); });
+    results.push_back({"format_" + format.name + "_write", entries, write});
+
+    long long size = stamp_files({out_file})[0].size;
+    std::cout << format.name << " output: " << size << " bytes\n";
+  }
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  if (argc != 3) {
+    std::cerr << "Usage: " << argv[0] << " <data directory> <results file>\n";
+    return 1;
+  }
+
+  std::vector<Phase_result> results;
+  run_mode(argv[1], false, results);
+  run_mode(argv[1], true, results);
+  run_multi_hypothesis(argv[1], results);
+  compare_formats(argv[1], results);
+
+  std::ofstream os(argv[2]);
+  if (!os.good()) {
+    std::cerr << "Error: Could not open results file " << argv[2] << '\n';
+    return 1;
+  }
+  os << "# phase entries_per_second\n";
+  for (const Phase_result& r : results) {
+    double rate = r.seconds > 0 ? r.entries / r.seconds : 0;
+    std::cout << r.name << ": " << r.entries << " entries in " << r.seconds
+              << " s (" << rate << " entries/s)\n";
+    os << r.name << ' ' << rate << '\n';
+  }
+  return 0;
+}
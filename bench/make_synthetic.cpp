@@ -0,0 +1,113 @@
+#include <TFile.h>
+#include <TTree.h>
+
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+// writes fixed synthetic flat trees for the benchmark: a primary hypothesis
+// and NUM_ALTS alternatives, each sharing a different fraction of its events.
+// the generator is seeded so every run produces identical input.
+
+namespace {
+
+constexpr unsigned NUM_EVENTS = 200000;
+constexpr unsigned FIRST_RUN = 30400;
+constexpr unsigned EVENTS_PER_RUN = 20000;
+// fraction of primary events present in each alternative
+constexpr double ALT_OVERLAP[] = {0.7, 0.5, 0.3, 0.9};
+constexpr unsigned NUM_ALTS = sizeof(ALT_OVERLAP) / sizeof(ALT_OVERLAP[0]);
+
+struct Flat_tree {
+  TFile* file;
+  TTree* tree;
+  unsigned long long event;
+  unsigned int run;
+  unsigned int beam_beamid;
+  float kin_chisq;
+  unsigned kin_ndf;
+
+  Flat_tree(const std::string& path, const std::string& name)
+      : file(TFile::Open(path.c_str(), "RECREATE")),
+        tree(new TTree(name.c_str(), name.c_str())) {
+    tree->Branch("event", &event);
+    tree->Branch("run", &run);
+    tree->Branch("beam_beamid", &beam_beamid);
+    tree->Branch("kin_chisq", &kin_chisq);
+    tree->Branch("kin_ndf", &kin_ndf);
+  }
+
+  void close() {
+    file->Write();
+    file->Close();
+    delete file;
+  }
+};
+
+// fills all combos of one event: several beam photons, several combos each
+void fill_event(Flat_tree& out, std::mt19937& rng, unsigned run,
+                unsigned long long event) {
+  std::uniform_int_distribution<unsigned> beams(1, 3);
+  std::uniform_int_distribution<unsigned> combos(1, 3);
+  std::uniform_int_distribution<unsigned> ndf(5, 10);
+  std::exponential_distribution<float> chisq(0.05f);
+
+  out.run = run;
+  out.event = event;
+  unsigned num_beams = beams(rng);
+  for (unsigned beam = 0; beam < num_beams; beam++) {
+    out.beam_beamid = 100 + beam;
+    unsigned num_combos = combos(rng);
+    for (unsigned c = 0; c < num_combos; c++) {
+      out.kin_chisq = chisq(rng);
+      out.kin_ndf = ndf(rng);
+      out.tree->Fill();
+    }
+  }
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  if (argc != 2) {
+    std::cerr << "Usage: " << argv[0] << " <output directory>\n";
+    return 1;
+  }
+  std::string dir = argv[1];
+
+  std::mt19937 rng(1851);
+
+  // the first alternative keeps the single-alternative name used by the
+  // one-hypothesis benchmarks
+  Flat_tree primary(dir + "/tree_bench_primary.root", "bench_primary");
+  std::vector<std::unique_ptr<Flat_tree>> alts;
+  for (unsigned a = 0; a < NUM_ALTS; a++) {
+    std::string name =
+        a == 0 ? "bench_alt" : "bench_alt" + std::to_string(a + 1);
+    alts.emplace_back(new Flat_tree(dir + "/tree_" + name + ".root", name));
+  }
+  for (unsigned i = 0; i < NUM_EVENTS; i++) {
+    unsigned run = FIRST_RUN + i / EVENTS_PER_RUN;
+    unsigned long long event = 1000 + i;
+    fill_event(primary, rng, run, event);
+    for (unsigned a = 0; a < NUM_ALTS; a++) {
+      if (std::bernoulli_distribution(ALT_OVERLAP[a])(rng)) {
+        fill_event(*alts[a], rng, run, event);
+      }
+    }
+  }
+
+  std::cout << "Wrote " << primary.tree->GetEntries() << " primary entries";
+  for (const auto& alt : alts) {
+    std::cout << ", " << alt->tree->GetEntries() << " "
+              << alt->tree->GetName();
+  }
+  std::cout << " to " << dir << '\n';
+  primary.close();
+  for (auto& alt : alts) {
+    alt->close();
+  }
+  return 0;
+}
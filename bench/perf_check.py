@@ -0,0 +1,91 @@
+#!/usr/bin/env python3
+# Compares benchmark throughput against the checked-in baseline, which is
+# recorded with `make perf-baseline`.
+# Usage: perf_check.py <baseline> <results> <tolerance>
+# Fails (exit code 1) if any phase's entries/s dropped by more than the
+# tolerance (a fraction, e.g. 0.2 for 20%) relative to the baseline. If the
+# baseline was recorded on another host or CPU, the comparison is only
+# printed with a warning, since throughput differs between nodes.
+
+import os
+import sys
+
+def read_rates(path):
+    rates = {}
+    with open(path) as f:
+        for line in f:
+            line = line.strip()
+            if not line or line.startswith("#"):
+                continue
+            name, rate = line.split()
+            rates[name] = float(rate)
+    return rates
+
+def read_stamp(path):
+    # "# key: value" header lines written by `make perf-baseline`
+    stamp = {}
+    with open(path) as f:
+        for line in f:
+            if not line.startswith("#"):
+                break
+            key, _, value = line[1:].partition(":")
+            stamp[key.strip()] = value.strip()
+    return stamp
+
+def cpu_model():
+    try:
+        with open("/proc/cpuinfo") as f:
+            for line in f:
+                if line.startswith("model name"):
+                    return line.split(":", 1)[1].strip()
+    except OSError:
+        pass
+    return ""
+
+def main():
+    if len(sys.argv) != 4:
+        print(f"Usage: {sys.argv[0]} <baseline> <results> <tolerance>")
+        return 2
+
+    if not os.path.exists(sys.argv[1]):
+        print(f"No baseline at {sys.argv[1]}. Record one with "
+              "`make perf-baseline`.")
+        return 2
+    stamp = read_stamp(sys.argv[1])
+    print(f"Baseline recorded on {stamp.get('host', '?')}, "
+          f"{stamp.get('cores', '?')} cores, {stamp.get('cpu', '?')}, "
+          f"{stamp.get('date', '?')}")
+    host = os.uname().nodename
+    same_host = (stamp.get("host") == host and
+                 stamp.get("cpu", "") == cpu_model())
+    if not same_host:
+        print(f"WARNING: The baseline was recorded on another host or CPU "
+              f"than {host}; regressions are reported but do not fail.")
+
+    baseline = read_rates(sys.argv[1])
+    results = read_rates(sys.argv[2])
+    tolerance = float(sys.argv[3])
+
+    regressions = 0
+    for name, expected in baseline.items():
+        if name not in results:
+            print(f"MISSING  {name}: no result")
+            regressions += 1
+            continue
+        measured = results[name]
+        change = measured / expected - 1.0 if expected > 0 else 0.0
+        status = "OK"
+        if change < -tolerance:
+            status = "REGRESSED"
+            regressions += 1
+        print(f"{status:9}{name}: {measured:.0f} entries/s "
+              f"(baseline {expected:.0f}, {change:+.1%})")
+
+    if regressions:
+        print(f"{regressions} phase(s) regressed by more than {tolerance:.0%}")
+        return 1 if same_host else 0
+    print("No performance regressions.")
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -1,14 +1,40 @@
 #include "compare_hypotheses.h"
 
+#include <TFile.h>
+#include <TFileMerger.h>
+#include <TROOT.h>
+
+#include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <cstdio>
+#include <exception>
 #include <fstream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+
+#include "input_files.h"
+#include "match_encoding.h"
+#include "output_writer.h"
+#include "parallel.h"
+#include "perf_counters.h"
+
+using namespace std::chrono;
 
-// constructor for the hypothesis trees. passes input directly to RDataFrame
-// constructor.
+// constructor for the hypothesis trees. the glob is expanded up front so the
+// tree knows its input files.
 hypothesis_tree_base::hypothesis_tree_base(std::string glob,
                                            std::string tree_name,
                                            bool match_type)
-    : df(ROOT::RDataFrame(tree_name, glob)),
+    : hypothesis_tree_base(expand_glob(glob), tree_name, match_type) {}
+
+hypothesis_tree_base::hypothesis_tree_base(std::vector<std::string> files,
+                                           std::string tree_name,
+                                           bool match_type)
+    : df(files.empty() ? ROOT::RDataFrame(0)
+                       : ROOT::RDataFrame(tree_name, files)),
+      files(files),
       tree_name(tree_name),
       match_by_best_per_beam(match_type),
       logging(false) {}
@@ -23,13 +49,110 @@ bool hypothesis_tree_base::contains_event_id(
   return (event_beam_as_key_map.find(pair_key) != event_beam_as_key_map.end());
 }
 
-// loads relevant columns from the RDataFrame
+// loads relevant columns from the RDataFrame, or from a sample of it
 void hypothesis_tree_base::fill_column_vecs() {
-  event_column_data = *df.Take<unsigned long long>("event");
-  run_column_data = *df.Take<unsigned int>("run");
-  beam_column_data = *df.Take<unsigned int>("beam_beamid");
-  chi_sq_column_data = *df.Take<float>("kin_chisq");
-  ndf_column_data = *df.Take<unsigned>("kin_ndf");
+  if (files.empty()) {
+    return;
+  }
+  if (io.any()) {
+    fill_column_vecs_per_file();
+    return;
+  }
+  take_columns(df, sample.entries);
+}
+
+// all columns are booked before the first is read so they share one event
+// loop
+void hypothesis_tree_base::take_columns(ROOT::RDF::RNode node,
+                                        unsigned long long max_entries) {
+  const Sample_config s = sample;
+  switch (s.mode) {
+    case Sample_mode::entries:
+      node = node.Range(max_entries);
+      break;
+    case Sample_mode::events:
+      node = node.Filter(
+          [s](unsigned int run, unsigned long long event) {
+            return sample_event(s, run, event);
+          },
+          {"run", "event"});
+      break;
+    case Sample_mode::runs:
+      node = node.Filter(
+          [s](unsigned int run) { return sample_run(s, run); }, {"run"});
+      break;
+    case Sample_mode::none:
+      break;
+  }
+  auto events = node.Take<unsigned long long>("event");
+  auto runs = node.Take<unsigned int>("run");
+  auto beams = node.Take<unsigned int>("beam_beamid");
+  auto chi_sqs = node.Take<float>("kin_chisq");
+  auto ndfs = node.Take<unsigned>("kin_ndf");
+  event_column_data.insert(event_column_data.end(), events->begin(),
+                           events->end());
+  run_column_data.insert(run_column_data.end(), runs->begin(), runs->end());
+  beam_column_data.insert(beam_column_data.end(), beams->begin(),
+                          beams->end());
+  chi_sq_column_data.insert(chi_sq_column_data.end(), chi_sqs->begin(),
+                            chi_sqs->end());
+  ndf_column_data.insert(ndf_column_data.end(), ndfs->begin(), ndfs->end());
+}
+
+// reads the files in order through their own TTreeCache while the next file
+// is warmed in the background, and records how much was read and waited for
+void hypothesis_tree_base::fill_column_vecs_per_file() {
+  if (io.prefetch_next) {
+    ROOT::EnableThreadSafety();
+  }
+  file_prefetcher prefetcher(
+      tree_name, {"event", "run", "beam_beamid", "kin_chisq", "kin_ndf"});
+  io_stats = Io_stats();
+  for (size_t i = 0; i < files.size(); i++) {
+    io_stats.wait_seconds += prefetcher.wait();
+    if (io.prefetch_next && i + 1 < files.size()) {
+      prefetcher.start(files[i + 1]);
+    }
+
+    unsigned long long remaining = 0;
+    if (sample.mode == Sample_mode::entries) {
+      remaining = sample.entries - event_column_data.size();
+      if (remaining == 0) {
+        break;
+      }
+    }
+
+    steady_clock::time_point t1 = steady_clock::now();
+    std::unique_ptr<TFile> file(TFile::Open(files[i].c_str()));
+    TTree* tree = nullptr;
+    if (file && !file->IsZombie()) {
+      file->GetObject(tree_name.c_str(), tree);
+    }
+    if (!tree) {
+      throw std::runtime_error("Could not read tree " + tree_name + " from " +
+                               files[i]);
+    }
+    if (io.cache_size_mb > 0) {
+      tree->SetCacheSize(io.cache_size_mb * 1024 * 1024);
+    }
+    take_columns(ROOT::RDataFrame(*tree), remaining);
+    io_stats.bytes_read += file->GetBytesRead();
+    io_stats.read_calls += file->GetReadCalls();
+    io_stats.read_seconds +=
+        duration_cast<duration<double>>(steady_clock::now() - t1).count();
+    io_stats.files++;
+  }
+  io_stats.wait_seconds += prefetcher.wait();
+  io_stats.prefetch_bytes = prefetcher.get_bytes_read();
+
+  // one write so trees prepared in parallel do not interleave
+  std::ostringstream report;
+  report << "I/O " << tree_name << ": " << io_stats.files << " files, "
+         << io_stats.bytes_read / 1e6 << " MB in " << io_stats.read_calls
+         << " reads (" << io_stats.prefetch_bytes / 1e6
+         << " MB prefetched), " << io_stats.read_seconds << " s loading, "
+         << io_stats.wait_seconds << " s waiting for prefetch\n";
+  std::cout << report.str();
 }
 
 // fill each combo with data from the data columns
@@ -89,44 +212,103 @@ void hypothesis_tree_best_per_beam::filter_high_chi_sq_events() {
   }
 }
 
+void hypothesis_tree_base::load() {
+  if (loaded) {
+    return;
+  }
+  fill_column_vecs();
+  loaded = true;
+}
+
+// runs the data preparation once per tree so cached trees can be reused
+void hypothesis_tree_base::prepare() {
+  if (prepared) {
+    return;
+  }
+  load();
+  {
+    perf_phase phase(perf_counters, "filter " + tree_name,
+                     event_column_data.size());
+    filter_high_chi_sq_events();
+  }
+  prepared = true;
+}
+
+std::shared_ptr<hypothesis_tree_base> make_hypothesis_tree(
+    std::string file_glob, std::string tree_name, bool match_type) {
+  if (match_type) {
+    return std::make_shared<hypothesis_tree_best_per_beam>(file_glob, tree_name,
+                                                           match_type);
+  }
+  return std::make_shared<hypothesis_tree_best_combo>(file_glob, tree_name,
+                                                      match_type);
+}
+
+std::shared_ptr<hypothesis_tree_base> make_hypothesis_tree(
+    std::vector<std::string> files, std::string tree_name, bool match_type) {
+  if (match_type) {
+    return std::make_shared<hypothesis_tree_best_per_beam>(files, tree_name,
+                                                           match_type);
+  }
+  return std::make_shared<hypothesis_tree_best_combo>(files, tree_name,
+                                                      match_type);
+}
+
 // constructor for compare_hypotheses manager class. initializes two
 // hypothesisTrees and the match counter.
 compare_hypotheses::compare_hypotheses(
     std::string file_1, std::string tree_1,
     std::vector<Tree_config> alt_hypo_configs, bool match_type)
-    : matches(0),
-      match_by_best_per_beam(match_type),
+    : match_by_best_per_beam(match_type),
+      matches(0),
       num_hypos(alt_hypo_configs.size()) {
+  tree1 = make_hypothesis_tree(file_1, tree_1, match_by_best_per_beam);
+  alt_hypos.reserve(num_hypos);
+  for (Tree_config& config : alt_hypo_configs) {
+    alt_hypos.push_back(make_hypothesis_tree(config.filename, config.treename,
+                                             match_by_best_per_beam));
+  }
   if (match_by_best_per_beam) {
-    tree1 = new hypothesis_tree_best_per_beam(file_1, tree_1,
-                                              match_by_best_per_beam);
-    alt_hypos.reserve(num_hypos);
-    for (Tree_config& config : alt_hypo_configs) {
-      alt_hypos.push_back(new hypothesis_tree_best_per_beam(
-          config.filename, config.treename, match_by_best_per_beam));
-    }
-    matched_chi_sqs_by_beam.reserve(alt_hypo_configs.size());
+    matched_chi_sqs_by_beam.reserve(num_hypos);
   } else {
-    tree1 =
-        new hypothesis_tree_best_combo(file_1, tree_1, match_by_best_per_beam);
-    alt_hypos.reserve(num_hypos);
-    for (Tree_config& config : alt_hypo_configs) {
-      alt_hypos.push_back(new hypothesis_tree_best_combo(
-          config.filename, config.treename, match_by_best_per_beam));
-    }
-    matched_chi_sqs.reserve(alt_hypo_configs.size());
+    matched_chi_sqs.reserve(num_hypos);
   }
 }
 
+compare_hypotheses::compare_hypotheses(
+    std::shared_ptr<hypothesis_tree_base> primary,
+    std::vector<std::shared_ptr<hypothesis_tree_base>> alts, bool match_type)
+    : tree1(primary),
+      alt_hypos(alts),
+      match_by_best_per_beam(match_type),
+      matches(0),
+      num_hypos(alts.size()) {
+  if (match_by_best_per_beam) {
+    matched_chi_sqs_by_beam.reserve(num_hypos);
+  } else {
+    matched_chi_sqs.reserve(num_hypos);
+  }
+}
+
+void compare_hypotheses::set_encoding(const Output_encoding& e) {
+  std::string problem = encoding_error(e, alt_hypos.size());
+  if (!problem.empty()) {
+    throw std::invalid_argument(problem);
+  }
+  encoding = e;
+}
+
 // load hypothesisTrees' member data from file and cut all high-chisq combos
+// of the primary. alternatives are only loaded; find_matches decides whether
+// each one is reduced into its own index. trees that were already prepared
+// (cached) are not read again.
 void compare_hypotheses::prepare_data() {
-  tree1->fill_column_vecs();
-  tree1->filter_high_chi_sq_events();
+  tree1->prepare();
 
-  for (hypothesis_tree_base* tree : alt_hypos) {
-    tree->fill_column_vecs();
-    tree->filter_high_chi_sq_events();
-    if (tree->event_column_data.size() == 0) {
+  for (auto& tree : alt_hypos) {
+    tree->load();
+    // a tree without input files was left empty on purpose
+    if (tree->event_column_data.size() == 0 && !tree->get_files().empty()) {
       std::cout << "WARNING: Tree " << tree->get_tree_name()
                 << " is empty. Did you fill your flat tree?\n";
     }
@@ -144,9 +326,165 @@ bool compare_hypotheses::chi_sqs_equal(const float& a, const float& b) {
   }
 }
 
-// iterates over tree1's events and checks them against tree2's events.
-// events are logged to log_matches.txt and are stored in the matched_chi_sqs
-// map.
+namespace {
+
+enum class Join_plan {
+  probe_alt,      // walk the primary index, look up each key in the alt's
+  probe_primary,  // walk the alt's index, look up each key in the primary's
+  stream_alt      // reduce the alt's combos straight onto the primary's keys
+};
+
+// picks the sides of one primary/alternative join. the primary's index is
+// always built, since the writer filters on it. an alternative that is not
+// reduced yet and has more combos than the primary keeps is streamed
+// through the primary's index, so its own full index is never built.
+// otherwise the alternative is reduced (if a cached or shared tree was not
+// already) and the smaller of the two indexes is walked.
+template <typename Key>
+Join_plan plan_join(const std::map<Key, combo>& primary,
+                    hypothesis_tree_base& alt,
+                    const std::map<Key, combo>& alt_index) {
+  if (!alt.is_prepared() && alt.event_column_data.size() > primary.size()) {
+    return Join_plan::stream_alt;
+  }
+  alt.prepare();
+  return primary.size() <= alt_index.size() ? Join_plan::probe_alt
+                                            : Join_plan::probe_primary;
+}
+
+// entries the plan walks, for the per-entry counter rates
+template <typename Key>
+size_t walked_entries(Join_plan plan, const std::map<Key, combo>& primary,
+                      const hypothesis_tree_base& alt,
+                      const std::map<Key, combo>& alt_index) {
+  switch (plan) {
+    case Join_plan::probe_alt:
+      return primary.size();
+    case Join_plan::probe_primary:
+      return alt_index.size();
+    case Join_plan::stream_alt:
+      return alt.event_column_data.size();
+  }
+  return 0;
+}
+
+combo combo_at(const hypothesis_tree_base& tree, size_t i) {
+  combo c;
+  c.set_event(tree.event_column_data[i]);
+  c.set_run(tree.run_column_data[i]);
+  c.set_beam(tree.beam_column_data[i]);
+  c.set_chi_sq(tree.chi_sq_column_data[i]);
+  c.set_ndf(tree.ndf_column_data[i]);
+  return c;
+}
+
+// calls on_match(key, primary combo, alt combo) for every key present in
+// both reduced sides, in key order. with stream_alt, the alt's combos are
+// reduced on the fly with the same rule as filter_high_chi_sq_events (the
+// first lowest chisq wins), keeping only keys of the primary's index, so the
+// map built is bounded by the primary's size. key_of(i) gives the key of the
+// alt's i-th loaded combo.
+template <typename Key, typename Key_of, typename F>
+void join_reduced(Join_plan plan, const std::map<Key, combo>& primary,
+                  const hypothesis_tree_base& alt,
+                  const std::map<Key, combo>& alt_index, Key_of key_of,
+                  F on_match) {
+  switch (plan) {
+    case Join_plan::probe_alt:
+      for (const auto& pair : primary) {
+        auto it = alt_index.find(pair.first);
+        if (it != alt_index.end()) {
+          on_match(pair.first, pair.second, it->second);
+        }
+      }
+      break;
+    case Join_plan::probe_primary:
+      for (const auto& pair : alt_index) {
+        auto it = primary.find(pair.first);
+        if (it != primary.end()) {
+          on_match(pair.first, it->second, pair.second);
+        }
+      }
+      break;
+    case Join_plan::stream_alt: {
+      // best alt combo per primary key, with the primary combo it matches
+      std::map<Key, std::pair<const combo*, combo>> best;
+      for (size_t i = 0; i < alt.event_column_data.size(); i++) {
+        Key key = key_of(i);
+        auto p = primary.find(key);
+        if (p == primary.end()) {
+          continue;
+        }
+        auto it = best.find(key);
+        if (it == best.end()) {
+          best.emplace(key, std::make_pair(&p->second, combo_at(alt, i)));
+        } else if (it->second.second.get_chi_sq() >
+                   alt.chi_sq_column_data[i]) {
+          it->second.second = combo_at(alt, i);
+        }
+      }
+      for (const auto& pair : best) {
+        on_match(pair.first, *pair.second.first, pair.second.second);
+      }
+      break;
+    }
+  }
+}
+
+void report_join_plan(std::ostream& os, Join_plan plan,
+                      const hypothesis_tree_base& primary,
+                      const hypothesis_tree_base& alt, size_t primary_size,
+                      size_t alt_size) {
+  os << "Matching " << primary.get_tree_name() << " (" << primary_size
+     << " reduced combos) with " << alt.get_tree_name() << ": ";
+  switch (plan) {
+    case Join_plan::probe_alt:
+      os << "probing " << alt.get_tree_name() << "'s index (" << alt_size
+         << " reduced combos) with each " << primary.get_tree_name()
+         << " combo\n";
+      break;
+    case Join_plan::probe_primary:
+      os << "probing " << primary.get_tree_name() << "'s index with each of "
+         << alt_size << " reduced " << alt.get_tree_name() << " combos\n";
+      break;
+    case Join_plan::stream_alt:
+      os << "streaming " << alt.event_column_data.size() << " "
+         << alt.get_tree_name() << " combos through "
+         << primary.get_tree_name() << "'s index, without building "
+         << alt.get_tree_name() << "'s\n";
+      break;
+  }
+}
+
+}  // namespace
+
+// stores the alt's chisq/ndf for a key matched in both trees if the run IDs
+// agree, and logs it
+template <typename Key>
+void compare_hypotheses::store_match(std::map<Key, float>& match_map,
+                                     const Key& key,
+                                     const combo& primary_combo,
+                                     const combo& alt_combo,
+                                     std::ofstream& os) {
+  // run ID match check
+  if (alt_combo.get_run() != primary_combo.get_run()) {
+    return;
+  }
+
+  // store the match
+  match_map[key] = alt_combo.get_chi_sq() / alt_combo.get_ndf();
+  matches++;
+  if (logging) {
+    os << "Event ID: " << primary_combo.get_event()
+       << " found in both trees. Run IDs: " << primary_combo.get_run() << ','
+       << alt_combo.get_run() << " Beam IDs: " << primary_combo.get_beam_id()
+       << ',' << alt_combo.get_beam_id() << '\n';
+  }
+}
+
+// joins tree1's reduced combos with each alternative's, by the plan
+// plan_join picks per pair. events are logged to
+// log_matches.txt and are stored in the matched_chi_sqs map.
 void compare_hypotheses::find_matches() {
   std::ofstream os;
   if (logging) {
@@ -160,37 +498,37 @@ void compare_hypotheses::find_matches() {
 
   // match_by_best_per_beam true, match by best combo per beam ID
   if (match_by_best_per_beam) {
-    for (hypothesis_tree_base* alt_tree : alt_hypos) {
-      std::cout << "Number of unfiltered events in tree1: "
-                << tree1->event_column_data.size()
-                << " Number of unfiltered events in tree2: "
-                << alt_tree->event_column_data.size() << std::endl;
-      std::map<std::pair<unsigned long long, unsigned>, float> match_map;
-      for (const auto& pair : tree1->event_beam_as_key_map) {
-        // get iterator
-        auto alt_tree_it = alt_tree->event_beam_as_key_map.find(pair.first);
-
-        // check if key exists
-        if (alt_tree_it != alt_tree->event_beam_as_key_map.end()) {
-          const combo& alt_combo = alt_tree_it->second;
+    for (auto& alt_tree : alt_hypos) {
+      const auto& primary_index = tree1->event_beam_as_key_map;
+      const auto& alt_index = alt_tree->event_beam_as_key_map;
+      Join_plan plan = plan_join(primary_index, *alt_tree, alt_index);
+      // one write so comparisons running in parallel (all-vs-all) do not
+      // interleave
+      std::ostringstream report;
+      report << "Number of unfiltered events in " << tree1->get_tree_name()
+             << ": " << tree1->event_column_data.size()
+             << " Number of unfiltered events in "
+             << alt_tree->get_tree_name() << ": "
+             << alt_tree->event_column_data.size() << '\n';
+      report_join_plan(report, plan, *tree1, *alt_tree, primary_index.size(),
+                       alt_index.size());
+      std::cout << report.str() << std::flush;
 
-          // run ID match check
-          if (alt_combo.get_run() != pair.second.get_run()) {
-            continue;
-          }
-
-          // store the match
-          match_map[pair.first] = alt_combo.get_chi_sq() / alt_combo.get_ndf();
-          matches++;
-          if (logging) {
-            os << "Event ID: " << (pair.first).first
-               << " found in both trees. Run IDs: " << pair.second.get_run()
-               << ',' << alt_combo.get_run()
-               << " Beam IDs: " << pair.second.get_beam_id() << ','
-               << alt_combo.get_beam_id() << '\n';
-          }
-        }
-      }
+      perf_phase phase(
+          perf_counters, "match " + alt_tree->get_tree_name(),
+          walked_entries(plan, primary_index, *alt_tree, alt_index));
+      const hypothesis_tree_base& alt = *alt_tree;
+      std::map<std::pair<unsigned long long, unsigned>, float> match_map;
+      join_reduced(
+          plan, primary_index, alt, alt_index,
+          [&alt](size_t i) {
+            return std::make_pair(alt.event_column_data[i],
+                                  alt.beam_column_data[i]);
+          },
+          [&](const std::pair<unsigned long long, unsigned>& key,
+              const combo& primary_combo, const combo& alt_combo) {
+            store_match(match_map, key, primary_combo, alt_combo, os);
+          });
       // push the map onto compare_hypotheses' vector
       matched_chi_sqs_by_beam.push_back(match_map);
     }
@@ -201,33 +539,26 @@ void compare_hypotheses::find_matches() {
   }
 
   // match_by_best_per_beam false, match by best overall combo
-  for (hypothesis_tree_base* alt_tree : alt_hypos) {
-    std::map<unsigned long long, float> match_map;
-    for (const auto& pair : tree1->event_as_key_map) {
-      // get iterator
-      auto alt_tree_it = alt_tree->event_as_key_map.find(pair.first);
-
-      if (alt_tree_it != alt_tree->event_as_key_map.end()) {
-        const combo& alt_combo = alt_tree_it->second;
-
-        // run ID match check
-        if (alt_combo.get_run() != pair.second.get_run()) {
-          continue;
-        }
+  for (auto& alt_tree : alt_hypos) {
+    const auto& primary_index = tree1->event_as_key_map;
+    const auto& alt_index = alt_tree->event_as_key_map;
+    Join_plan plan = plan_join(primary_index, *alt_tree, alt_index);
+    std::ostringstream report;
+    report_join_plan(report, plan, *tree1, *alt_tree, primary_index.size(),
+                     alt_index.size());
+    std::cout << report.str() << std::flush;
 
-        // store the match
-        match_map[pair.first] = alt_combo.get_chi_sq() / alt_combo.get_ndf();
-        matches++;
-
-        if (logging) {
-          os << "Event ID: " << pair.first
-             << " found in both trees. Run IDs: " << pair.second.get_run()
-             << ',' << alt_combo.get_run()
-             << " Beam IDs: " << pair.second.get_beam_id() << ','
-             << alt_combo.get_beam_id() << '\n';
-        }
-      }
-    }
+    perf_phase phase(perf_counters, "match " + alt_tree->get_tree_name(),
+                     walked_entries(plan, primary_index, *alt_tree, alt_index));
+    const hypothesis_tree_base& alt = *alt_tree;
+    std::map<unsigned long long, float> match_map;
+    join_reduced(
+        plan, primary_index, alt, alt_index,
+        [&alt](size_t i) { return alt.event_column_data[i]; },
+        [&](const unsigned long long& key, const combo& primary_combo,
+            const combo& alt_combo) {
+          store_match(match_map, key, primary_combo, alt_combo, os);
+        });
     matched_chi_sqs.push_back(match_map);
   }
   if (logging) {
@@ -235,50 +566,85 @@ void compare_hypotheses::find_matches() {
   }
 }
 
-// writes alternative chisq values into new branch. if no match is found,
-// placeholder chisq is written instead. if preserve_combos is false (which is
-// the default), only the most probable combos from the primary tree and their
-// matches are written.
-void compare_hypotheses::write_to_file(std::string out_file) {
-  if (out_file == "placeholder" || out_file == "") {
-    out_file = std::to_string(num_hypos) + "_hypothesesMatched.root";
+// defines one dense column holding every alternative's chisq/ndf for the
+// entry (NO_MATCH_INDICATOR where unmatched), a branch per hypothesis read
+// from it, and the unique-combo filter. the lambdas' signatures fix every
+// column type, so none of these nodes needs the interpreter. the nodes only
+// read the match maps, so graphs over different files can run concurrently.
+ROOT::RDF::RNode compare_hypotheses::build_output_node(
+    ROOT::RDF::RNode df_node) {
+  if (match_by_best_per_beam) {
+    df_node = df_node.Define(
+        HYPOS_COLUMN,
+        [this](unsigned long long event, unsigned beam) {
+          ROOT::RVec<float> values(num_hypos, NO_MATCH_INDICATOR);
+          auto key = std::make_pair(event, beam);
+          for (size_t i = 0; i < num_hypos; i++) {
+            auto it = matched_chi_sqs_by_beam[i].find(key);
+            if (it != matched_chi_sqs_by_beam[i].end()) {
+              values[i] = it->second;
+            }
+          }
+          return values;
+        },
+        {"event", "beam_beamid"});
+  } else {
+    df_node = df_node.Define(HYPOS_COLUMN,
+                             [this](unsigned long long event) {
+                               ROOT::RVec<float> values(num_hypos,
+                                                        NO_MATCH_INDICATOR);
+                               for (size_t i = 0; i < num_hypos; i++) {
+                                 auto it = matched_chi_sqs[i].find(event);
+                                 if (it != matched_chi_sqs[i].end()) {
+                                   values[i] = it->second;
+                                 }
+                               }
+                               return values;
+                             },
+                             {"event"});
   }
 
-  float NO_MATCH_INDICATOR = 185100000.0f;
-
-  // write to a computation graph node instead of the actual RDF
-  ROOT::RDF::RNode df_node = tree1->df;
-
   // loop over all alternative hypotheses; add a new branch for each's alt
   // chisqs
-  for (int i = 0; i < alt_hypos.size(); i++) {
-    hypothesis_tree_base* alt_tree = alt_hypos[i];
-    auto branchName = alt_tree->get_tree_name() + "_chisq_ndf";
-
-    if (match_by_best_per_beam) {
-      auto& matched_chi_sqs_ref = matched_chi_sqs_by_beam[i];
-      df_node = df_node.Define(
-          branchName,
-          [&matched_chi_sqs_ref, NO_MATCH_INDICATOR](unsigned long long event,
-                                                     unsigned beam) -> float {
-            auto key = std::make_pair(event, beam);
-            auto it = matched_chi_sqs_ref.find(key);
-            return it != matched_chi_sqs_ref.end() ? it->second
-                                                   : NO_MATCH_INDICATOR;
-          },
-          {"event", "beam_beamid"});
-    } else {
-      auto& matched_chi_sqs_ref = matched_chi_sqs[i];
-      df_node = df_node.Define(branchName,
-                               [&matched_chi_sqs_ref, NO_MATCH_INDICATOR](
-                                   unsigned long long event) -> float {
-                                 auto it = matched_chi_sqs_ref.find(event);
-                                 return it != matched_chi_sqs_ref.end()
-                                            ? it->second
-                                            : NO_MATCH_INDICATOR;
-                               },
-                               {"event"});
-    }
+  std::vector<std::string> branch_names = hypo_branch_names();
+  const Output_encoding enc = encoding;
+  for (size_t i = 0; i < branch_names.size(); i++) {
+    df_node = df_node.Define(
+        branch_names[i],
+        [i, enc](const ROOT::RVec<float>& values) -> float {
+          return encode_chisq_ndf(values[i], enc);
+        },
+        {HYPOS_COLUMN});
+  }
+  if (encoding.compact) {
+    df_node = df_node.Define(
+        MATCH_MASK_COLUMN,
+        [](const ROOT::RVec<float>& values) { return match_mask(values); },
+        {HYPOS_COLUMN});
+  }
+
+  // all summaries come from one pass over the dense hypothesis values; the
+  // selected ones are then split out of it
+  if (derived.any()) {
+    df_node = df_node.Define(
+        DERIVED_COLUMN,
+        [enc](float kin_chisq, unsigned kin_ndf,
+              const ROOT::RVec<float>& values) {
+          return compute_derived(kin_chisq, kin_ndf, values, enc);
+        },
+        {"kin_chisq", "kin_ndf", HYPOS_COLUMN});
+    df_node = df_node.Define(
+        BEST_HYPOTHESIS_COLUMN,
+        [](const Derived_values& d) { return d.best_hypothesis; },
+        {DERIVED_COLUMN});
+    df_node = df_node.Define(
+        CHISQ_NDF_DELTA_COLUMN,
+        [](const Derived_values& d) { return d.chisq_ndf_delta; },
+        {DERIVED_COLUMN});
+    df_node = df_node.Define(
+        NUM_ALT_MATCHED_COLUMN,
+        [](const Derived_values& d) { return d.num_alt_matched; },
+        {DERIVED_COLUMN});
   }
 
   // preserve only the lowest chisq combo per event ID & beam ID if
@@ -307,7 +673,174 @@ void compare_hypotheses::write_to_file(std::string out_file) {
         },
         {"event", "kin_chisq"});
   }
+  return df_node;
+}
 
+std::vector<std::string> compare_hypotheses::hypo_branch_names() const {
+  std::vector<std::string> names;
+  for (const auto& alt_tree : alt_hypos) {
+    names.push_back(alt_tree->get_tree_name() + "_chisq_ndf");
+  }
+  return names;
+}
+
+// writes alternative chisq values into new branch. if no match is found,
+// placeholder chisq is written instead. if preserve_combos is false (which is
+// the default), only the most probable combos from the primary tree and their
+// matches are written.
+bool compare_hypotheses::write_to_file(std::string out_file) {
+  if (out_file == "placeholder" || out_file == "") {
+    out_file = std::to_string(num_hypos) + "_hypothesesMatched.root";
+  }
+
+  // counts the whole event loop, including the threads of write_parallel
+  perf_phase phase(perf_counters, "write",
+                   tree1->event_column_data.size());
+
+  if (num_threads > 1 && tree1->get_files().size() > 1) {
+    if (!rntuple_output) {
+      return write_parallel(out_file);
+    }
+    std::cout << "WARNING: RNTuple partitions cannot be merged, writing with "
+                 "a single thread.\n";
+  }
+
+  // write to a computation graph node instead of the actual RDF
+  ROOT::RDF::RNode df_node = build_output_node(tree1->df);
+
+  // stamp the first entry that reaches the writer. the time before it is
+  // spent opening files and, for the Snapshot path, JIT-compiling the writer.
+  bool first_entry_seen = false;
+  steady_clock::time_point first_entry_time;
+  df_node = df_node.Filter(
+      [&first_entry_seen, &first_entry_time]() -> bool {
+        if (!first_entry_seen) {
+          first_entry_seen = true;
+          first_entry_time = steady_clock::now();
+        }
+        return true;
+      },
+      {});
+  steady_clock::time_point loop_start = steady_clock::now();
+
+  if (!write_node(df_node, out_file, snapshot_columns())) {
+    return false;
+  }
+
+  if (first_entry_seen) {
+    auto startup = duration_cast<microseconds>(first_entry_time - loop_start);
+    std::cout << "Time to first entry: " << startup.count() * 1E-6
+              << " seconds\n";
+  }
+  return true;
+}
+
+Output_layout compare_hypotheses::output_layout() const {
+  Output_layout layout;
+  layout.hypo_branches = hypo_branch_names();
+  layout.encoding = encoding;
+  layout.derived = derived;
+  return layout;
+}
+
+// all columns of the primary tree plus one branch per hypothesis; the dense
+// helper columns are not written
+ROOT::RDF::ColumnNames_t compare_hypotheses::snapshot_columns() {
+  ROOT::RDF::ColumnNames_t columns = tree1->df.GetColumnNames();
+  for (const std::string& name : hypo_branch_names()) {
+    columns.push_back(name);
+  }
+  if (encoding.compact) {
+    columns.push_back(MATCH_MASK_COLUMN);
+  }
+  if (derived.best_hypothesis) {
+    columns.push_back(BEST_HYPOTHESIS_COLUMN);
+  }
+  if (derived.chisq_ndf_delta) {
+    columns.push_back(CHISQ_NDF_DELTA_COLUMN);
+  }
+  if (derived.num_alt_matched) {
+    columns.push_back(NUM_ALT_MATCHED_COLUMN);
+  }
+  return columns;
+}
+
+// runs the event loop of node into out_file with the selected backend
+bool compare_hypotheses::write_node(ROOT::RDF::RNode node,
+                                    const std::string& out_file,
+                                    const ROOT::RDF::ColumnNames_t& columns) {
+  if (rntuple_output) {
+    return write_rntuple(node, out_file, output_layout());
+  }
+  if (compiled_output) {
+    return write_compiled_tree(node, out_file, output_layout());
+  }
   // process the RNodes and write to file
-  df_node.Snapshot("hypothesesMatched", out_file);
+  node.Snapshot("hypothesesMatched", out_file, columns);
+  return true;
+}
+
+// each primary file gets its own event loop on a worker thread, writing a
+// partition next to the output. the partitions are then merged by copying
+// their compressed baskets, in input order if preserve_order is set and in
+// completion order otherwise.
+bool compare_hypotheses::write_parallel(const std::string& out_file) {
+  ROOT::EnableThreadSafety();
+
+  const std::vector<std::string>& files = tree1->get_files();
+  const std::string tree_name = tree1->get_tree_name();
+  const ROOT::RDF::ColumnNames_t columns = snapshot_columns();
+  std::vector<std::string> partitions;
+  for (size_t i = 0; i < files.size(); i++) {
+    partitions.push_back(out_file + ".part" + std::to_string(i));
+  }
+
+  std::mutex done_mutex;
+  std::vector<size_t> done_order;
+  bool all_written = true;
+  std::exception_ptr error;
+
+  std::cout << "Writing " << files.size() << " files with "
+            << std::min<size_t>(num_threads, files.size()) << " threads\n";
+  try {
+    parallel_for(files.size(), num_threads, [&](size_t i) {
+      ROOT::RDataFrame df(tree_name, files[i]);
+      bool written = write_node(build_output_node(df), partitions[i], columns);
+      std::lock_guard<std::mutex> lock(done_mutex);
+      if (written) {
+        done_order.push_back(i);
+      } else {
+        all_written = false;
+      }
+    });
+  } catch (...) {
+    error = std::current_exception();
+  }
+
+  bool merged = false;
+  if (!error && all_written) {
+    if (preserve_order) {
+      std::sort(done_order.begin(), done_order.end());
+    }
+    TFileMerger merger(false);
+    merger.SetFastMethod(true);
+    merger.SetPrintLevel(0);
+    merged = merger.OutputFile(out_file.c_str(), "RECREATE");
+    for (size_t i : done_order) {
+      merged = merged && merger.AddFile(partitions[i].c_str(), false);
+    }
+    merged = merged && merger.Merge();
+    if (!merged) {
+      std::cerr << "Error: Could not merge partitions into " << out_file
+                << '\n';
+    }
+  }
+
+  for (const std::string& partition : partitions) {
+    std::remove(partition.c_str());
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+  return merged;
 }
@@ -1,10 +1,25 @@
+#ifndef COMPARE_HYPOTHESES_H
+#define COMPARE_HYPOTHESES_H
+
 #include <map>
+#include <memory>
 #include <vector>
 #include <string>
+#include <fstream>
 #include <iostream>
 #include <ROOT/RDataFrame.hxx>
 #include <ROOT/RVec.hxx>
 
+#include "derived_columns.h"
+#include "io_tuning.h"
+#include "match_encoding.h"
+#include "sampling.h"
+
+struct Output_layout;
+
+// dense per-entry column holding every alternative hypothesis' chisq/ndf
+constexpr const char* HYPOS_COLUMN = "hypos_chisq_ndf";
+
 struct Tree_config {
   std::string filename;
   std::string treename;
@@ -38,20 +53,46 @@ class hypothesis_tree_base {
  public:
   hypothesis_tree_base(std::string file_glob, std::string tree_name,
                        bool match_type);
+  // reads exactly the given files. an empty list gives an empty tree.
+  hypothesis_tree_base(std::vector<std::string> files, std::string tree_name,
+                       bool match_type);
   virtual ~hypothesis_tree_base() = default;
   // data preperation functions
   virtual void update_combo_data(size_t index) = 0;
   virtual void filter_high_chi_sq_events() = 0;
 
+  // loads the columns once; later calls are no-ops
+  void load();
+  bool is_loaded() const { return loaded; }
+
+  // loads the columns and reduces them into the combo maps once; later
+  // calls are no-ops
+  void prepare();
+  bool is_prepared() const { return prepared; }
+
   bool is_matching_by_beam() const { return match_by_best_per_beam; }
   void set_match_by_beam(bool m) { match_by_best_per_beam = m; }
 
   bool is_logging() const { return logging; }
   void set_logging(bool l) { logging = l; }
 
+  // restricts the loaded columns to a sample. set before prepare().
+  const Sample_config& get_sample() const { return sample; }
+  void set_sample(const Sample_config& s) { sample = s; }
+
+  // read tuning for fill_column_vecs. set before prepare().
+  const Io_options& get_io() const { return io; }
+  void set_io(const Io_options& i) { io = i; }
+  const Io_stats& get_io_stats() const { return io_stats; }
+
+  // per-phase hardware counters around filter_high_chi_sq_events
+  bool is_counting_perf() const { return perf_counters; }
+  void set_perf_counters(bool p) { perf_counters = p; }
+
   bool contains_event_id(std::pair<unsigned long long, unsigned>) const;
   void fill_column_vecs();
   std::string get_tree_name() const { return tree_name; }
+  const std::vector<std::string>& get_files() const { return files; }
 
   // combo maps
   std::map<std::pair<unsigned long long, unsigned>, combo>
@@ -69,10 +110,23 @@ class hypothesis_tree_base {
   std::vector<unsigned> ndf_column_data;
 
  private:
+  std::vector<std::string> files;
   std::string tree_name;
   bool match_by_best_per_beam;  // whether matching by best combo per beam is
                                 // used
   bool logging;
+  bool loaded = false;
+  bool prepared = false;
+  Sample_config sample;
+  Io_options io;
+  Io_stats io_stats;
+  bool perf_counters = false;
+
+  // appends the (sampled) columns of node, with at most max_entries entries
+  // in Sample_mode::entries
+  void take_columns(ROOT::RDF::RNode node, unsigned long long max_entries);
+  // loads one file at a time with the io options applied
+  void fill_column_vecs_per_file();
 };
 
 class hypothesis_tree_best_combo : public hypothesis_tree_base {
@@ -80,6 +134,9 @@ class hypothesis_tree_best_combo : public hypothesis_tree_base {
   hypothesis_tree_best_combo(std::string file_glob, std::string tree_name,
                              bool match_type)
       : hypothesis_tree_base(file_glob, tree_name, match_type) {}
+  hypothesis_tree_best_combo(std::vector<std::string> files, std::string tree_name,
+                             bool match_type)
+      : hypothesis_tree_base(files, tree_name, match_type) {}
   void update_combo_data(size_t index) override;
   void filter_high_chi_sq_events() override;
 };
@@ -89,35 +146,76 @@ class hypothesis_tree_best_per_beam : public hypothesis_tree_base {
   hypothesis_tree_best_per_beam(std::string file_glob, std::string tree_name,
                                 bool match_type)
       : hypothesis_tree_base(file_glob, tree_name, match_type) {}
+  hypothesis_tree_best_per_beam(std::vector<std::string> files, std::string tree_name,
+                                bool match_type)
+      : hypothesis_tree_base(files, tree_name, match_type) {}
   void update_combo_data(size_t index) override;
   void filter_high_chi_sq_events() override;
 };
 
+// builds the tree subclass matching the requested matching mode
+std::shared_ptr<hypothesis_tree_base> make_hypothesis_tree(
+    std::string file_glob, std::string tree_name, bool match_type);
+std::shared_ptr<hypothesis_tree_base> make_hypothesis_tree(
+    std::vector<std::string> files, std::string tree_name, bool match_type);
+
 class compare_hypotheses {
  private:
-  hypothesis_tree_base* tree1;
-  std::vector<hypothesis_tree_base*> alt_hypos;
+  std::shared_ptr<hypothesis_tree_base> tree1;
+  std::vector<std::shared_ptr<hypothesis_tree_base>> alt_hypos;
   bool logging = false;         // whether logs of matches are written to file
   bool match_by_best_per_beam;  // whether matching by best combo per beam is
                                 // used
   bool preserve_combos =
       false;  // whether to keep combos with high chisq in the output file
+  bool compiled_output =
+      false;  // whether to write through the JIT-free typed writer
+  bool rntuple_output = false;  // whether to write an RNTuple, not a TTree
+  unsigned num_threads = 1;  // writer threads, one primary file per task
+  bool preserve_order = true;  // whether merged output keeps input file order
+  Output_encoding encoding;  // full floats, or match_mask + reduced precision
+  Derived_selection derived;  // cross-hypothesis summary columns to write
+  bool perf_counters = false;  // count matching and writing phases
+
+  // defines the matched chisq/ndf branches and the unique-combo filter on top
+  // of a node reading the primary tree (or one of its files)
+  ROOT::RDF::RNode build_output_node(ROOT::RDF::RNode df_node);
+
+  Output_layout output_layout() const;
+  ROOT::RDF::ColumnNames_t snapshot_columns();
+  bool write_node(ROOT::RDF::RNode node, const std::string& out_file,
+                  const ROOT::RDF::ColumnNames_t& columns);
+  bool write_parallel(const std::string& out_file);
+  template <typename Key>
+  void store_match(std::map<Key, float>& match_map, const Key& key,
+                   const combo& primary_combo, const combo& alt_combo,
+                   std::ofstream& os);
  public:
   compare_hypotheses(std::string glob1, std::string tree1,
                      std::vector<Tree_config> alt_hypo_configs,
                      bool match_type);
 
+  // uses already constructed (and possibly already prepared) trees, e.g. ones
+  // kept warm by the daemon's tree cache
+  compare_hypotheses(std::shared_ptr<hypothesis_tree_base> primary,
+                     std::vector<std::shared_ptr<hypothesis_tree_base>> alts,
+                     bool match_type);
+
   // calls each tree's data preperation functions
   void prepare_data();
 
   // performs combo matching between each tree's combo map
   void find_matches();
 
-  // outputs into a new branch in a clone of the primary RDataFrame
-  void write_to_file(std::string out_file);
+  // outputs into a new branch in a clone of the primary RDataFrame. returns
+  // false if the output could not be written.
+  bool write_to_file(std::string out_file);
+
+  // names of the per-hypothesis output branches, in alt_hypos order
+  std::vector<std::string> hypo_branch_names() const;
 
   // float equality function
-  bool chi_sqs_equal(const float& a, const float& b);
+  static bool chi_sqs_equal(const float& a, const float& b);
 
   // counter for number of matches
   uint matches;
@@ -128,12 +226,16 @@ class compare_hypotheses {
       matched_chi_sqs_by_beam;
   std::vector<std::map<unsigned long long, float>> matched_chi_sqs;
 
+  // read-only access to the trees, e.g. for reporting
+  const hypothesis_tree_base& primary_tree() const { return *tree1; }
+  const hypothesis_tree_base& alt_tree(size_t i) const { return *alt_hypos[i]; }
+
   // helpers and member data setters
   bool is_logging() const { return logging; }
   void set_logging(bool l) {
     logging = l;
     tree1->set_logging(l);
-    for (hypothesis_tree_base* tree : alt_hypos) {
+    for (auto& tree : alt_hypos) {
       tree->set_logging(l);
     }
   }
@@ -141,19 +243,50 @@ class compare_hypotheses {
   bool is_preserving() const { return preserve_combos; }
   void set_preserving(bool p) { preserve_combos = p; }
 
+  bool is_compiled_output() const { return compiled_output; }
+  void set_compiled_output(bool c) { compiled_output = c; }
+
+  bool is_rntuple_output() const { return rntuple_output; }
+  void set_rntuple_output(bool r) { rntuple_output = r; }
+
+  unsigned get_threads() const { return num_threads; }
+  void set_threads(unsigned t) { num_threads = t; }
+
+  bool is_preserving_order() const { return preserve_order; }
+  void set_preserve_order(bool p) { preserve_order = p; }
+
+  const Output_encoding& get_encoding() const { return encoding; }
+  // throws std::invalid_argument if the encoding cannot be written for this
+  // comparison's hypotheses
+  void set_encoding(const Output_encoding& e);
+
+  void set_io(const Io_options& io) {
+    tree1->set_io(io);
+    for (auto& tree : alt_hypos) {
+      tree->set_io(io);
+    }
+  }
+
+  bool is_counting_perf() const { return perf_counters; }
+  void set_perf_counters(bool p) {
+    perf_counters = p;
+    tree1->set_perf_counters(p);
+    for (auto& tree : alt_hypos) {
+      tree->set_perf_counters(p);
+    }
+  }
+
+  const Derived_selection& get_derived() const { return derived; }
+  void set_derived(const Derived_selection& d) { derived = d; }
+
   bool is_matching_by_beam() const { return match_by_best_per_beam; }
   void set_match_by_beam(bool m) {
     match_by_best_per_beam = m;
     tree1->set_match_by_beam(m);
-    for (hypothesis_tree_base* tree : alt_hypos) {
+    for (auto& tree : alt_hypos) {
       tree->set_match_by_beam(m);
     }
   }
+};
 
-  ~compare_hypotheses() {
-    delete tree1;
-    for (hypothesis_tree_base* tree : alt_hypos) {
-      delete tree;
-    }
-  }
-};
\ No newline at end of file
+#endif
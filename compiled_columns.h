@@ -0,0 +1,15 @@
+#ifndef COMPILED_COLUMNS_H
+#define COMPILED_COLUMNS_H
+
+// primary-tree columns copied by the JIT-free writer (compiled_output = true)
+// in addition to event, run, beam_beamid, kin_chisq and kin_ndf. each entry is
+// X(type, branch_name); the types must match the input tree exactly. edit the
+// list and rebuild, e.g.:
+/*
+  #define COMPILED_EXTRA_COLUMNS(X) \
+    X(float, pi0_mass)              \
+    X(unsigned int, num_showers)
+*/
+#define COMPILED_EXTRA_COLUMNS(X)
+
+#endif
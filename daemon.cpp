@@ -0,0 +1,281 @@
+#include "daemon.h"
+
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include "inih/INIReader.h"
+#include "job.h"
+#include "tree_cache.h"
+
+namespace {
+
+volatile sig_atomic_t stop_requested = 0;
+
+void request_stop(int) { stop_requested = 1; }
+
+bool make_address(const std::string& socket_path, sockaddr_un& address) {
+  if (socket_path.size() >= sizeof(address.sun_path)) {
+    std::cerr << "Socket path " << socket_path << " is too long.\n";
+    return false;
+  }
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+  return true;
+}
+
+// reads until the peer shuts down its writing side
+std::string read_all(int fd) {
+  std::string data;
+  char buffer[4096];
+  ssize_t n;
+  while ((n = read(fd, buffer, sizeof(buffer))) != 0) {
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+    data.append(buffer, n);
+  }
+  return data;
+}
+
+void write_all(int fd, const std::string& data) {
+  size_t written = 0;
+  while (written < data.size()) {
+    ssize_t n = write(fd, data.data() + written, data.size() - written);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return;
+    }
+    written += n;
+  }
+}
+
+// redirects fd 1 and 2 into a pipe for its lifetime, so everything a job
+// prints reaches the client: std::cout and std::cerr from any of its threads
+// (both stay synchronized with stdio, which locks per write) and ROOT's own
+// Error/Warning messages. a reader thread drains the pipe so writers never
+// block on a full pipe.
+class output_capture {
+ public:
+  output_capture() {
+    int fds[2];
+    fflush(stdout);
+    fflush(stderr);
+    if (pipe(fds) != 0) {
+      return;
+    }
+    saved_out = dup(STDOUT_FILENO);
+    saved_err = dup(STDERR_FILENO);
+    dup2(fds[1], STDOUT_FILENO);
+    dup2(fds[1], STDERR_FILENO);
+    close(fds[1]);
+    read_fd = fds[0];
+    reader = std::thread([this]() { text = read_all(read_fd); });
+  }
+  ~output_capture() { finish(); }
+
+  output_capture(const output_capture&) = delete;
+  output_capture& operator=(const output_capture&) = delete;
+
+  // restores fd 1 and 2 and returns everything written in between. if the
+  // pipe could not be created, output went to the server's console instead.
+  std::string finish() {
+    if (read_fd < 0) {
+      return text;
+    }
+    std::cout.flush();
+    std::cerr.flush();
+    fflush(stdout);
+    fflush(stderr);
+    // closing the last write ends lets the reader see the end of the pipe
+    dup2(saved_out, STDOUT_FILENO);
+    dup2(saved_err, STDERR_FILENO);
+    close(saved_out);
+    close(saved_err);
+    reader.join();
+    close(read_fd);
+    read_fd = -1;
+    return text;
+  }
+
+ private:
+  int saved_out = -1;
+  int saved_err = -1;
+  int read_fd = -1;
+  std::thread reader;
+  std::string text;
+};
+
+// parses and runs one job with its output captured for the client.
+// relative paths in the job (globs, outfile, log_matches.txt) are resolved
+// against the client's working directory. returns the job's exit status.
+int handle_job(const std::string& request, tree_cache& cache,
+               std::string& log_text) {
+  output_capture capture;
+  int status = 1;
+
+  // the request is "cwd <dir>\n" followed by the INI text
+  size_t newline = request.find('\n');
+  std::string job_text;
+  std::string client_cwd;
+  if (request.compare(0, 4, "cwd ") == 0 && newline != std::string::npos) {
+    client_cwd = request.substr(4, newline - 4);
+    job_text = request.substr(newline + 1);
+  }
+
+  char server_cwd[PATH_MAX];
+  if (client_cwd.empty()) {
+    std::cerr << "Error: malformed job request.\n";
+  } else if (!getcwd(server_cwd, sizeof(server_cwd)) ||
+             chdir(client_cwd.c_str()) != 0) {
+    std::cerr << "Error: could not change to " << client_cwd << ": "
+              << strerror(errno) << '\n';
+  } else {
+    FILE* job_file = fmemopen(const_cast<char*>(job_text.data()),
+                              job_text.size(), "r");
+    if (!job_file) {
+      std::cerr << "Error: could not read job description.\n";
+    } else {
+      INIReader reader(job_file);
+      fclose(job_file);
+
+      Job_config config;
+      if (reader.ParseError() != 0) {
+        std::cerr << "Error parsing job description at line "
+                  << reader.ParseError() << '\n';
+      } else if (read_job_config(reader, config)) {
+        try {
+          status = run_job(config, &cache);
+        } catch (const std::exception& e) {
+          // a broken job must not take the warm cache down with it
+          std::cerr << "Error: " << e.what() << '\n';
+          cache.clear();
+        }
+      }
+    }
+    if (chdir(server_cwd) != 0) {
+      std::cerr << "WARNING: could not return to " << server_cwd << '\n';
+    }
+  }
+
+  log_text = capture.finish();
+  return status;
+}
+
+}  // namespace
+
+int serve(const std::string& socket_path, size_t max_cached_trees) {
+  sockaddr_un address;
+  if (!make_address(socket_path, address)) {
+    return 1;
+  }
+
+  int server_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (server_fd < 0) {
+    std::cerr << "Error: could not create socket: " << strerror(errno) << '\n';
+    return 1;
+  }
+  unlink(socket_path.c_str());
+  if (bind(server_fd, reinterpret_cast<sockaddr*>(&address),
+           sizeof(address)) < 0 ||
+      listen(server_fd, 8) < 0) {
+    std::cerr << "Error: could not listen on " << socket_path << ": "
+              << strerror(errno) << '\n';
+    close(server_fd);
+    return 1;
+  }
+
+  // no SA_RESTART, so a signal interrupts accept() and ends the loop
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = request_stop;
+  sigaction(SIGINT, &action, nullptr);
+  sigaction(SIGTERM, &action, nullptr);
+  signal(SIGPIPE, SIG_IGN);
+
+  std::cout << "Serving comparison jobs on " << socket_path << std::endl;
+  tree_cache cache(max_cached_trees);
+  while (!stop_requested) {
+    int client_fd = accept(server_fd, nullptr, nullptr);
+    if (client_fd < 0) {
+      continue;
+    }
+    std::string job_text = read_all(client_fd);
+    std::cout << "Received job (" << cache.size() << " trees cached)"
+              << std::endl;
+    // the status line goes first so the client can use it as exit code
+    std::string log;
+    int status = handle_job(job_text, cache, log);
+    write_all(client_fd, "status " + std::to_string(status) + '\n' + log);
+    close(client_fd);
+  }
+
+  std::cout << "Shutting down server.\n";
+  close(server_fd);
+  unlink(socket_path.c_str());
+  return 0;
+}
+
+int submit(const std::string& socket_path, const std::string& config_file) {
+  std::ifstream is(config_file);
+  if (!is.good()) {
+    std::cerr << "Error reading config file " << config_file << '\n';
+    return 1;
+  }
+  std::stringstream job_text;
+  job_text << is.rdbuf();
+
+  sockaddr_un address;
+  if (!make_address(socket_path, address)) {
+    return 1;
+  }
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&address),
+                        sizeof(address)) < 0) {
+    std::cerr << "Error: could not connect to " << socket_path << ": "
+              << strerror(errno) << '\n';
+    if (fd >= 0) {
+      close(fd);
+    }
+    return 1;
+  }
+
+  char cwd[PATH_MAX];
+  if (!getcwd(cwd, sizeof(cwd))) {
+    std::cerr << "Error: could not get the working directory: "
+              << strerror(errno) << '\n';
+    close(fd);
+    return 1;
+  }
+  write_all(fd, std::string("cwd ") + cwd + '\n' + job_text.str());
+  shutdown(fd, SHUT_WR);
+  std::string response = read_all(fd);
+  close(fd);
+
+  size_t newline = response.find('\n');
+  if (response.compare(0, 7, "status ") != 0 ||
+      newline == std::string::npos) {
+    std::cerr << "Error: malformed response from the server.\n";
+    return 1;
+  }
+  std::cout << response.substr(newline + 1);
+  return std::atoi(response.substr(7, newline - 7).c_str());
+}
@@ -0,0 +1,18 @@
+#ifndef DAEMON_H
+#define DAEMON_H
+
+#include <cstddef>
+#include <string>
+
+// listens on a Unix socket and runs each received config (same INI format as
+// config.ini) against a warm tree cache holding at most max_cached_trees
+// trees. relative paths are resolved against the submitting client's working
+// directory. the job's log and exit status are sent back to the client.
+// returns when interrupted.
+int serve(const std::string& socket_path, size_t max_cached_trees);
+
+// sends the config file to a running server, prints the job's log and
+// returns the job's exit status
+int submit(const std::string& socket_path, const std::string& config_file);
+
+#endif
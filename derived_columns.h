@@ -0,0 +1,102 @@
+#ifndef DERIVED_COLUMNS_H
+#define DERIVED_COLUMNS_H
+
+#include <string>
+
+#include <ROOT/RVec.hxx>
+
+#include "match_encoding.h"
+
+// per-entry summaries over all hypotheses, written next to the per-hypothesis
+// branches so hypothesis-rejection cuts need no second pass over the output
+
+constexpr const char* BEST_HYPOTHESIS_COLUMN = "best_hypothesis";
+constexpr const char* CHISQ_NDF_DELTA_COLUMN = "chisq_ndf_delta";
+constexpr const char* NUM_ALT_MATCHED_COLUMN = "num_alt_matched";
+
+// dense per-entry column holding all three summaries, in the order above
+constexpr const char* DERIVED_COLUMN = "derived_hypothesis_values";
+
+// which summaries are written
+struct Derived_selection {
+  bool best_hypothesis = false;
+  bool chisq_ndf_delta = false;
+  bool num_alt_matched = false;
+
+  bool any() const {
+    return best_hypothesis || chisq_ndf_delta || num_alt_matched;
+  }
+};
+
+struct Derived_values {
+  // hypothesis with the lowest chisq/ndf, numbered like the config sections:
+  // 1 is the primary, 2 the first alternative, and so on
+  int best_hypothesis;
+  // primary chisq/ndf minus the lowest matched alternative's. if no
+  // alternative matched it is NO_MATCH_INDICATOR, or 0 with compact output,
+  // where the match_mask tells readers it is not set.
+  float chisq_ndf_delta;
+  unsigned int num_alt_matched;
+};
+
+inline Derived_values compute_derived(float kin_chisq, unsigned kin_ndf,
+                                      const ROOT::RVec<float>& values,
+                                      const Output_encoding& encoding) {
+  float primary = kin_chisq / kin_ndf;
+  float best_alt = NO_MATCH_INDICATOR;
+  int best_alt_index = -1;
+  unsigned int matched = 0;
+  for (size_t i = 0; i < values.size(); i++) {
+    if (values[i] == NO_MATCH_INDICATOR) {
+      continue;
+    }
+    matched++;
+    if (best_alt_index < 0 || values[i] < best_alt) {
+      best_alt = values[i];
+      best_alt_index = i;
+    }
+  }
+
+  Derived_values derived;
+  derived.num_alt_matched = matched;
+  if (best_alt_index < 0) {
+    derived.best_hypothesis = 1;
+    derived.chisq_ndf_delta = encoding.compact ? 0.0f : NO_MATCH_INDICATOR;
+  } else {
+    derived.best_hypothesis = best_alt < primary ? best_alt_index + 2 : 1;
+    derived.chisq_ndf_delta = primary - best_alt;
+  }
+  return derived;
+}
+
+// parses a comma-separated list of summary column names. returns false and
+// sets bad_name on an unknown name.
+inline bool parse_derived_selection(const std::string& list,
+                                    Derived_selection& selection,
+                                    std::string& bad_name) {
+  selection = Derived_selection();
+  size_t start = 0;
+  while (start <= list.size()) {
+    size_t end = list.find(',', start);
+    if (end == std::string::npos) {
+      end = list.size();
+    }
+    std::string name = list.substr(start, end - start);
+    name.erase(0, name.find_first_not_of(" \t"));
+    name.erase(name.find_last_not_of(" \t") + 1);
+    if (name == BEST_HYPOTHESIS_COLUMN) {
+      selection.best_hypothesis = true;
+    } else if (name == CHISQ_NDF_DELTA_COLUMN) {
+      selection.chisq_ndf_delta = true;
+    } else if (name == NUM_ALT_MATCHED_COLUMN) {
+      selection.num_alt_matched = true;
+    } else if (!name.empty()) {
+      bad_name = name;
+      return false;
+    }
+    start = end + 1;
+  }
+  return true;
+}
+
+#endif
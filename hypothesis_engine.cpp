@@ -0,0 +1,158 @@
+#include "hypothesis_engine.h"
+
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+
+#include "compare_hypotheses.h"
+#include "inih/INIReader.h"
+#include "io_tuning.h"
+#include "job.h"
+#include "tree_cache.h"
+
+namespace {
+
+// a comparison of freshly read, sampled trees. sampled trees are never put
+// into the engine's cache, which holds full trees.
+std::unique_ptr<compare_hypotheses> make_sampled_comparison(
+    const Job_config& config) {
+  std::vector<std::shared_ptr<hypothesis_tree_base>> alts;
+  for (const Tree_config& tree : config.alt_hypos) {
+    alts.push_back(make_hypothesis_tree(tree.filename, tree.treename,
+                                        config.best_by_beam));
+    alts.back()->set_sample(config.sample);
+  }
+  std::shared_ptr<hypothesis_tree_base> primary = make_hypothesis_tree(
+      config.primary.filename, config.primary.treename, config.best_by_beam);
+  primary->set_sample(config.sample);
+  std::unique_ptr<compare_hypotheses> c(
+      new compare_hypotheses(primary, alts, config.best_by_beam));
+  apply_options(*c, config);
+  return c;
+}
+
+}  // namespace
+
+struct hypothesis_engine::impl {
+  Tree_config primary;
+  std::vector<Tree_config> alts;
+  std::map<std::string, std::string> options;
+  tree_cache cache;
+
+  // builds the config through the same INI parsing and checks as a
+  // config.ini file
+  bool make_config(Job_config& config) const {
+    std::ostringstream ini;
+    ini << "[1]\nglob = " << primary.filename << "\ntree = "
+        << primary.treename << "\nnum_alt_hypos = " << alts.size() << '\n';
+    for (size_t i = 0; i < alts.size(); i++) {
+      ini << '[' << i + 2 << "]\nglob = " << alts[i].filename
+          << "\ntree = " << alts[i].treename << '\n';
+    }
+    ini << "[Misc]\n";
+    for (const auto& pair : options) {
+      ini << pair.first << " = " << pair.second << '\n';
+    }
+
+    std::string text = ini.str();
+    FILE* file = fmemopen(const_cast<char*>(text.data()), text.size(), "r");
+    if (!file) {
+      return false;
+    }
+    INIReader reader(file);
+    fclose(file);
+    return reader.ParseError() == 0 && read_job_config(reader, config);
+  }
+};
+
+hypothesis_engine::hypothesis_engine() : d(new impl) {}
+
+hypothesis_engine::~hypothesis_engine() = default;
+
+void hypothesis_engine::set_primary(const std::string& file_glob,
+                                    const std::string& tree_name) {
+  d->primary = {file_glob, tree_name};
+}
+
+void hypothesis_engine::add_alternative(const std::string& file_glob,
+                                        const std::string& tree_name) {
+  d->alts.push_back({file_glob, tree_name});
+}
+
+void hypothesis_engine::clear_alternatives() { d->alts.clear(); }
+
+void hypothesis_engine::set_option(const std::string& name,
+                                   const std::string& value) {
+  d->options[name] = value;
+}
+
+void hypothesis_engine::clear_options() { d->options.clear(); }
+
+size_t hypothesis_engine::num_cached_trees() const { return d->cache.size(); }
+
+void hypothesis_engine::clear_cache() { d->cache.clear(); }
+
+Match_result hypothesis_engine::match() {
+  Job_config config;
+  if (!d->make_config(config)) {
+    throw std::invalid_argument("invalid comparison configuration");
+  }
+  // these only change how run() produces its output files
+  if (config.streaming || config.incremental || config.all_vs_all) {
+    throw std::invalid_argument(
+        "streaming, incremental and all_vs_all only apply to run()");
+  }
+  io_options_scope io_scope(config.io);
+  std::unique_ptr<compare_hypotheses> c =
+      config.preview ? make_sampled_comparison(config)
+                     : make_comparison(config, &d->cache);
+  c->prepare_data();
+  c->find_matches();
+
+  Match_result result;
+  result.matches = c->matches;
+  for (size_t h = 0; h < c->num_hypos; h++) {
+    result.hypotheses.push_back(c->alt_tree(h).get_tree_name());
+  }
+  result.chisq_ndf.resize(c->num_hypos);
+
+  // appends one primary combo and its matches in every hypothesis
+  auto add_combo = [&result](const combo& primary_combo, auto find_match) {
+    result.events.push_back(primary_combo.get_event());
+    result.runs.push_back(primary_combo.get_run());
+    result.beams.push_back(primary_combo.get_beam_id());
+    for (size_t h = 0; h < result.chisq_ndf.size(); h++) {
+      result.chisq_ndf[h].push_back(find_match(h));
+    }
+  };
+
+  const hypothesis_tree_base& primary = c->primary_tree();
+  if (config.best_by_beam) {
+    for (const auto& pair : primary.event_beam_as_key_map) {
+      add_combo(pair.second, [&c, &pair](size_t h) {
+        auto it = c->matched_chi_sqs_by_beam[h].find(pair.first);
+        return it != c->matched_chi_sqs_by_beam[h].end() ? it->second
+                                                         : NO_MATCH_INDICATOR;
+      });
+    }
+  } else {
+    for (const auto& pair : primary.event_as_key_map) {
+      add_combo(pair.second, [&c, &pair](size_t h) {
+        auto it = c->matched_chi_sqs[h].find(pair.first);
+        return it != c->matched_chi_sqs[h].end() ? it->second
+                                                 : NO_MATCH_INDICATOR;
+      });
+    }
+  }
+  return result;
+}
+
+int hypothesis_engine::run() {
+  Job_config config;
+  if (!d->make_config(config)) {
+    return 1;
+  }
+  return run_job(config, &d->cache);
+}
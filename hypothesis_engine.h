@@ -0,0 +1,70 @@
+#ifndef HYPOTHESIS_ENGINE_H
+#define HYPOTHESIS_ENGINE_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "match_encoding.h"
+
+// bumped whenever the interface below changes incompatibly
+constexpr int HYPOTHESIS_ENGINE_API_VERSION = 2;
+
+// matches of one comparison, one entry per reduced primary combo (per event,
+// or per event and beam ID when matching by best combo per beam)
+struct Match_result {
+  std::vector<std::string> hypotheses;  // alternative tree names
+  std::vector<unsigned long long> events;
+  std::vector<unsigned int> runs;
+  std::vector<unsigned int> beams;
+  // chisq_ndf[h][i] is hypothesis h's chisq/ndf for primary combo i, or
+  // NO_MATCH_INDICATOR if it has no match
+  std::vector<std::vector<float>> chisq_ndf;
+  unsigned long long matches = 0;
+};
+
+// stable in-process entry point to the matching engine, exported by
+// libcompare_hypotheses.so and usable from Python through PyROOT/cppyy (see
+// hypothesis_engine.py). the comparison is described through setters, and
+// options use their config.ini [Misc] names and values, so new options need
+// no interface change. trees stay loaded between calls and are reloaded only
+// when their input files change.
+class hypothesis_engine {
+ public:
+  hypothesis_engine();
+  ~hypothesis_engine();
+  hypothesis_engine(const hypothesis_engine&) = delete;
+  hypothesis_engine& operator=(const hypothesis_engine&) = delete;
+
+  static int api_version() { return HYPOTHESIS_ENGINE_API_VERSION; }
+
+  void set_primary(const std::string& file_glob, const std::string& tree_name);
+  void add_alternative(const std::string& file_glob,
+                       const std::string& tree_name);
+  void clear_alternatives();
+
+  // sets a [Misc] option, e.g. set_option("best_per_beam", "true"). options
+  // are validated when match() or run() is called.
+  void set_option(const std::string& name, const std::string& value);
+  void clear_options();
+
+  // prepares and matches the configured comparison; nothing is written to
+  // disk. with preview, only the configured sample is matched (and not
+  // cached). throws std::invalid_argument if the configuration is invalid or
+  // sets streaming, incremental or all_vs_all, which only apply to run().
+  Match_result match();
+
+  // prepares, matches and writes the output, like one run of the
+  // executable. returns the executable's exit status.
+  int run();
+
+  // number of trees currently kept loaded
+  size_t num_cached_trees() const;
+  void clear_cache();
+
+ private:
+  struct impl;
+  std::unique_ptr<impl> d;
+};
+
+#endif
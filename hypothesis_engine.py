@@ -0,0 +1,61 @@
+# In-process access to the matching engine in libcompare_hypotheses.so through
+# PyROOT. Loaded trees stay in memory inside an Engine between calls, so a
+# driver script can compare many runs without starting a new ROOT process for
+# each one.
+#
+# Example:
+#
+#   from hypothesis_engine import Engine, configure
+#   engine = Engine()
+#   configure(engine, ("/data/hypo1/tree_hypo1_flat_030450.root", "hypo1"),
+#             [("/data/hypo2/tree_hypo2_flat_030450.root", "hypo2")],
+#             best_per_beam=True)
+#   result = engine.match()                  # match arrays, nothing written
+#   print(result.matches, list(result.chisq_ndf[0])[:10])
+#   engine.set_option("outfile", "030450_matched.root")
+#   engine.run()                             # same as running the executable
+
+import os
+
+import ROOT
+
+_DIR = os.path.dirname(os.path.abspath(__file__))
+
+# the interface version this wrapper was written against
+API_VERSION = 2
+
+ROOT.gInterpreter.AddIncludePath(_DIR)
+if ROOT.gSystem.Load(os.path.join(_DIR, "libcompare_hypotheses.so")) < 0:
+    raise ImportError("could not load libcompare_hypotheses.so; run `make lib` first")
+ROOT.gInterpreter.Declare('#include "hypothesis_engine.h"')
+
+Engine = ROOT.hypothesis_engine
+NO_MATCH_INDICATOR = ROOT.NO_MATCH_INDICATOR
+
+if Engine.api_version() != API_VERSION:
+    raise ImportError(f"libcompare_hypotheses.so has API version "
+                      f"{Engine.api_version()}, expected {API_VERSION}")
+
+
+def _option_value(value):
+    if isinstance(value, bool):
+        return "true" if value else "false"
+    if isinstance(value, (list, tuple)):
+        return ",".join(str(v) for v in value)
+    return str(value)
+
+
+def configure(engine, primary, alternatives, **options):
+    """Sets the (glob, tree) pairs of a comparison and its options.
+
+    Options take their config.ini [Misc] names and values, e.g.
+    best_per_beam=True, threads=4 or derived_columns=["best_hypothesis"].
+    Options set earlier on the engine are cleared first.
+    """
+    engine.set_primary(*primary)
+    engine.clear_alternatives()
+    for glob, tree in alternatives:
+        engine.add_alternative(glob, tree)
+    engine.clear_options()
+    for name, value in options.items():
+        engine.set_option(name, _option_value(value))
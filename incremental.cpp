@@ -0,0 +1,318 @@
+#include "incremental.h"
+
+#include <sys/stat.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+#include "input_files.h"
+
+namespace {
+
+constexpr const char* MANIFEST_NAME = "manifest.txt";
+
+struct Manifest_entry {
+  File_range file;
+  std::string partition;  // output partition, primary files only
+};
+
+using Manifest_files = std::map<std::string, Manifest_entry>;
+
+struct Manifest {
+  std::string options;
+  Manifest_files primary;
+  std::vector<Manifest_files> alts;  // one per alternative hypothesis
+};
+
+// everything besides the inputs that changes the content of all partitions
+std::string options_key(const Job_config& config) {
+  std::ostringstream key;
+  key << config.primary.treename;
+  for (const Tree_config& alt : config.alt_hypos) {
+    key << ',' << alt.treename;
+  }
+  key << " best_per_beam=" << config.best_by_beam
+      << " preserve_combos=" << config.preserve_combos
+      << " compiled_output=" << config.compiled_output
+      << " rntuple_output=" << config.rntuple_output
+      << " compact_output=" << config.encoding.compact;
+  if (config.encoding.compact) {
+    key << " chisq_mantissa_bits=" << config.encoding.mantissa_bits;
+  }
+  key << " derived_columns=" << config.derived.best_hypothesis
+      << config.derived.chisq_ndf_delta << config.derived.num_alt_matched;
+  return key.str();
+}
+
+// a missing or unreadable manifest is treated as empty, so everything is
+// processed
+Manifest read_manifest(const std::string& path) {
+  Manifest manifest;
+  std::ifstream is(path);
+  std::string line;
+  while (std::getline(is, line)) {
+    std::vector<std::string> fields = split_tabs(line);
+    try {
+      if (fields.size() == 2 && fields[0] == "options") {
+        manifest.options = fields[1];
+      } else if (fields.size() == 2 + FILE_RANGE_FIELDS &&
+                 fields[0] == "primary") {
+        Manifest_entry entry;
+        entry.file = parse_file_range(fields, 1);
+        entry.partition = fields[1 + FILE_RANGE_FIELDS];
+        manifest.primary[entry.file.stamp.path] = entry;
+      } else if (fields.size() == 2 + FILE_RANGE_FIELDS &&
+                 fields[0] == "alt") {
+        size_t hypo = std::stoul(fields[1]);
+        if (manifest.alts.size() <= hypo) {
+          manifest.alts.resize(hypo + 1);
+        }
+        Manifest_entry entry;
+        entry.file = parse_file_range(fields, 2);
+        manifest.alts[hypo][entry.file.stamp.path] = entry;
+      }
+    } catch (const std::exception&) {
+      std::cout << "WARNING: Ignoring malformed manifest line: " << line
+                << '\n';
+    }
+  }
+  return manifest;
+}
+
+// files that could not be scanned are left out, so the next run retries them
+bool write_manifest(const std::string& path, const Manifest& manifest) {
+  // written next to the old one and renamed, so an interrupted write never
+  // leaves a truncated manifest behind
+  std::string tmp_path = path + ".tmp";
+  std::ofstream os(tmp_path);
+  if (!os.good()) {
+    return false;
+  }
+  os << "# compare_hypotheses incremental manifest\n";
+  os << "options\t" << manifest.options << '\n';
+  for (const auto& pair : manifest.primary) {
+    if (!pair.second.file.scanned) {
+      continue;
+    }
+    os << "primary\t";
+    write_file_range(os, pair.second.file);
+    os << '\t' << pair.second.partition << '\n';
+  }
+  for (size_t h = 0; h < manifest.alts.size(); h++) {
+    for (const auto& pair : manifest.alts[h]) {
+      if (!pair.second.file.scanned) {
+        continue;
+      }
+      os << "alt\t" << h << '\t';
+      write_file_range(os, pair.second.file);
+      os << '\n';
+    }
+  }
+  os.close();
+  return os.good() && std::rename(tmp_path.c_str(), path.c_str()) == 0;
+}
+
+// the files matched by glob, reusing the recorded range of files that did
+// not change
+Manifest_files survey(const std::string& glob, const std::string& tree_name,
+                      const Manifest_files& old, unsigned num_threads) {
+  File_ranges known;
+  for (const auto& pair : old) {
+    known[pair.first] = pair.second.file;
+  }
+  Manifest_files files;
+  for (const auto& pair :
+       survey_files(glob, tree_name, known, num_threads)) {
+    files[pair.first].file = pair.second;
+  }
+  return files;
+}
+
+// key ranges of alternative files that were added, changed or removed. combos
+// are reduced by event number across runs, so any primary partition whose
+// events overlap one of them has to be rebuilt, whatever its runs.
+std::vector<Key_range> changed_ranges(const Manifest_files& old,
+                                      const Manifest_files& current) {
+  std::vector<Key_range> ranges;
+  for (const auto& pair : current) {
+    auto it = old.find(pair.first);
+    if (it == old.end() || it->second.file.stamp != pair.second.file.stamp) {
+      ranges.push_back(pair.second.file.range);
+      if (it != old.end()) {
+        ranges.push_back(it->second.file.range);
+      }
+    }
+  }
+  for (const auto& pair : old) {
+    if (current.find(pair.first) == current.end()) {
+      ranges.push_back(pair.second.file.range);
+    }
+  }
+  return ranges;
+}
+
+// the input's basename plus a hash of its full path, so inputs with the same
+// name in different directories get different partitions. FNV-1a is used
+// because, unlike std::hash, it is the same in every build.
+std::string partition_name(const std::string& out_dir,
+                           const std::string& input) {
+  std::uint64_t hash = 14695981039346656037ULL;
+  for (char c : input) {
+    hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ULL;
+  }
+  char hex[17];
+  std::snprintf(hex, sizeof(hex), "%016llx",
+                static_cast<unsigned long long>(hash));
+
+  std::string base = input.substr(input.find_last_of('/') + 1);
+  if (base.size() > 5 && base.compare(base.size() - 5, 5, ".root") == 0) {
+    base.erase(base.size() - 5);
+  }
+  return out_dir + "/" + base + "_" + hex + "_hypothesesMatched.root";
+}
+
+bool file_exists(const std::string& path) {
+  struct stat info;
+  return stat(path.c_str(), &info) == 0;
+}
+
+}  // namespace
+
+int run_incremental_job(const Job_config& config) {
+  std::string out_dir = config.out_file;
+  if (out_dir == "placeholder" || out_dir == "") {
+    out_dir = std::to_string(config.alt_hypos.size()) + "_hypothesesMatched";
+  }
+  if (mkdir(out_dir.c_str(), 0755) != 0 && errno != EEXIST) {
+    std::cerr << "Error: Could not create output directory " << out_dir
+              << ": " << strerror(errno) << '\n';
+    return 1;
+  }
+  std::string manifest_path = out_dir + "/" + MANIFEST_NAME;
+
+  Manifest old = read_manifest(manifest_path);
+  Manifest current;
+  current.options = options_key(config);
+  bool options_changed = old.options != current.options;
+  if (options_changed && !old.options.empty()) {
+    std::cout << "Configuration changed since the last run, rebuilding all "
+                 "partitions.\n";
+  }
+  old.alts.resize(config.alt_hypos.size());
+
+  current.primary = survey(config.primary.filename, config.primary.treename,
+                           old.primary, config.threads);
+  std::vector<Key_range> changed_alt_ranges;
+  for (size_t h = 0; h < config.alt_hypos.size(); h++) {
+    current.alts.push_back(survey(config.alt_hypos[h].filename,
+                                  config.alt_hypos[h].treename, old.alts[h],
+                                  config.threads));
+    std::vector<Key_range> ranges =
+        changed_ranges(old.alts[h], current.alts[h]);
+    changed_alt_ranges.insert(changed_alt_ranges.end(), ranges.begin(),
+                              ranges.end());
+  }
+
+  // drop partitions of primary files that no longer exist
+  size_t removed = 0;
+  for (const auto& pair : old.primary) {
+    if (current.primary.find(pair.first) == current.primary.end()) {
+      std::remove(pair.second.partition.c_str());
+      removed++;
+    }
+  }
+
+  // partition names must be unique, or one input would overwrite another's
+  std::map<std::string, std::string> partition_inputs;
+  for (auto& pair : current.primary) {
+    pair.second.partition = partition_name(out_dir, pair.first);
+    auto inserted =
+        partition_inputs.insert({pair.second.partition, pair.first});
+    if (!inserted.second) {
+      std::cerr << "Error: " << pair.first << " and "
+                << inserted.first->second << " map to the same partition "
+                << pair.second.partition << ".\n";
+      return 1;
+    }
+  }
+
+  size_t rebuilt = 0;
+  size_t failed = 0;
+  unsigned long long total_matches = 0;
+  for (auto pair_it = current.primary.begin();
+       pair_it != current.primary.end();) {
+    Manifest_entry& entry = pair_it->second;
+
+    auto it = old.primary.find(pair_it->first);
+    bool stale = options_changed || it == old.primary.end() ||
+                 it->second.file.stamp != entry.file.stamp ||
+                 it->second.partition != entry.partition ||
+                 !file_exists(entry.partition);
+    for (const Key_range& range : changed_alt_ranges) {
+      stale = stale || entry.file.range.events_overlap(range);
+    }
+    if (!stale) {
+      ++pair_it;
+      continue;
+    }
+
+    std::cout << "Processing " << entry.file.stamp.path << '\n';
+    // every alternative file holding one of this file's event numbers takes
+    // part in the reduction of that event, whatever its runs, so the
+    // alternative side is reduced exactly as in a full run
+    std::vector<std::shared_ptr<hypothesis_tree_base>> alts;
+    for (size_t h = 0; h < config.alt_hypos.size(); h++) {
+      std::vector<std::string> files;
+      for (const auto& alt : current.alts[h]) {
+        if (alt.second.file.range.events_overlap(entry.file.range)) {
+          files.push_back(alt.first);
+        }
+      }
+      alts.push_back(make_hypothesis_tree(files, config.alt_hypos[h].treename,
+                                          config.best_by_beam));
+    }
+    // the primary side is reduced within this file only, see the README
+    compare_hypotheses c(
+        make_hypothesis_tree(std::vector<std::string>{entry.file.stamp.path},
+                             config.primary.treename, config.best_by_beam),
+        alts, config.best_by_beam);
+    apply_options(c, config);
+    c.prepare_data();
+    c.find_matches();
+    if (!c.write_to_file(entry.partition)) {
+      // left out of the manifest, so the next run tries again
+      std::cerr << "Error: Could not write partition " << entry.partition
+                << '\n';
+      std::remove(entry.partition.c_str());
+      pair_it = current.primary.erase(pair_it);
+      failed++;
+      continue;
+    }
+    // partitions named by an older scheme are replaced
+    if (it != old.primary.end() && !it->second.partition.empty() &&
+        it->second.partition != entry.partition) {
+      std::remove(it->second.partition.c_str());
+    }
+    total_matches += c.matches;
+    rebuilt++;
+    ++pair_it;
+  }
+
+  if (!write_manifest(manifest_path, current)) {
+    std::cerr << "Error: Could not write manifest " << manifest_path << '\n';
+    return 1;
+  }
+
+  std::cout << "Partitions rebuilt: " << rebuilt << ", up to date: "
+            << current.primary.size() - rebuilt << ", removed: " << removed
+            << ", failed: " << failed << '\n';
+  std::cout << "Number of matches in rebuilt partitions: " << total_matches
+            << std::endl;
+  return failed ? 1 : 0;
+}
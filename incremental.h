@@ -0,0 +1,13 @@
+#ifndef INCREMENTAL_H
+#define INCREMENTAL_H
+
+#include "job.h"
+
+// incremental mode: the output is a directory with one partition file per
+// primary input file and a manifest recording every input's size, mtime and
+// run range. a re-run only rebuilds partitions whose primary file is new or
+// changed, or whose runs overlap an alternative file that was added, changed
+// or removed. partitions of deleted primary files are removed.
+int run_incremental_job(const Job_config& config);
+
+#endif
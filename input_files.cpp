@@ -0,0 +1,198 @@
+#include "input_files.h"
+
+#include <glob.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+#include <ROOT/RDataFrame.hxx>
+#include <TROOT.h>
+
+#include "parallel.h"
+
+std::vector<std::string> expand_glob(const std::string& pattern) {
+  std::vector<std::string> paths;
+  glob_t results;
+  if (glob(pattern.c_str(), 0, nullptr, &results) == 0) {
+    for (size_t i = 0; i < results.gl_pathc; ++i) {
+      paths.push_back(results.gl_pathv[i]);
+    }
+  }
+  globfree(&results);
+
+  if (paths.empty()) {
+    paths.push_back(pattern);
+  }
+  std::sort(paths.begin(), paths.end());
+  return paths;
+}
+
+std::vector<File_stamp> stamp_files(const std::vector<std::string>& paths) {
+  std::vector<File_stamp> stamps;
+  stamps.reserve(paths.size());
+  for (const std::string& path : paths) {
+    struct stat info;
+    if (stat(path.c_str(), &info) == 0) {
+      stamps.push_back({path, static_cast<long long>(info.st_size),
+                        info.st_mtime});
+    } else {
+      stamps.push_back({path, -1, 0});
+    }
+  }
+  return stamps;
+}
+
+bool scan_key_range(const std::string& path, const std::string& tree_name,
+                    Key_range& range) {
+  range = Key_range();
+  try {
+    ROOT::RDataFrame df(tree_name, path);
+    auto count = df.Count();
+    auto min_run = df.Min<unsigned int>("run");
+    auto max_run = df.Max<unsigned int>("run");
+    auto min_event = df.Min<unsigned long long>("event");
+    auto max_event = df.Max<unsigned long long>("event");
+    if (*count > 0) {
+      range.runs.min = *min_run;
+      range.runs.max = *max_run;
+      range.runs.empty = false;
+      range.min_event = *min_event;
+      range.max_event = *max_event;
+    }
+  } catch (const std::exception& e) {
+    std::cout << "WARNING: Could not scan " << path << ": " << e.what()
+              << '\n';
+    return false;
+  }
+  return true;
+}
+
+File_ranges survey_files(const std::string& glob, const std::string& tree_name,
+                         const File_ranges& known, unsigned num_threads) {
+  File_ranges files;
+  std::vector<File_range*> to_scan;
+  for (const File_stamp& stamp : stamp_files(expand_glob(glob))) {
+    File_range& file = files[stamp.path];
+    file.stamp = stamp;
+    auto it = known.find(stamp.path);
+    if (stamp.size >= 0 && it != known.end() && it->second.scanned &&
+        it->second.stamp == stamp) {
+      file = it->second;
+    } else if (stamp.size >= 0) {
+      to_scan.push_back(&file);
+    }
+  }
+
+  if (!to_scan.empty()) {
+    std::cout << "Scanning " << to_scan.size() << " files of " << tree_name
+              << "..." << std::endl;
+    if (num_threads > 1) {
+      ROOT::EnableThreadSafety();
+    }
+    parallel_for(to_scan.size(), num_threads,
+                 [&to_scan, &tree_name](size_t i) {
+                   File_range& file = *to_scan[i];
+                   file.scanned =
+                       scan_key_range(file.stamp.path, tree_name, file.range);
+                 });
+  }
+  return files;
+}
+
+std::vector<std::string> split_tabs(const std::string& line) {
+  std::vector<std::string> fields;
+  std::stringstream ss(line);
+  std::string field;
+  while (std::getline(ss, field, '\t')) {
+    fields.push_back(field);
+  }
+  return fields;
+}
+
+void write_file_range(std::ostream& os, const File_range& file) {
+  os << file.stamp.path << '\t' << file.stamp.size << '\t'
+     << static_cast<long long>(file.stamp.mtime) << '\t'
+     << file.range.runs.empty << '\t' << file.range.runs.min << '\t'
+     << file.range.runs.max << '\t' << file.range.min_event << '\t'
+     << file.range.max_event;
+}
+
+File_range parse_file_range(const std::vector<std::string>& fields,
+                            size_t first) {
+  if (fields.size() < first + FILE_RANGE_FIELDS) {
+    throw std::invalid_argument("too few fields");
+  }
+  File_range file;
+  file.stamp.path = fields[first];
+  file.stamp.size = std::stoll(fields[first + 1]);
+  file.stamp.mtime = static_cast<std::time_t>(std::stoll(fields[first + 2]));
+  file.range.runs.empty = fields[first + 3] == "1";
+  file.range.runs.min = std::stoul(fields[first + 4]);
+  file.range.runs.max = std::stoul(fields[first + 5]);
+  file.range.min_event = std::stoull(fields[first + 6]);
+  file.range.max_event = std::stoull(fields[first + 7]);
+  file.scanned = true;
+  return file;
+}
+
+// one line per file: tree name, then the file range
+range_cache::range_cache(std::string path) : path(std::move(path)) {
+  std::ifstream is(this->path);
+  std::string line;
+  while (std::getline(is, line)) {
+    std::vector<std::string> fields = split_tabs(line);
+    if (fields.size() != 1 + FILE_RANGE_FIELDS) {
+      continue;
+    }
+    try {
+      File_range file = parse_file_range(fields, 1);
+      trees[fields[0]][file.stamp.path] = file;
+    } catch (const std::exception&) {
+      continue;
+    }
+  }
+}
+
+File_ranges range_cache::survey(const std::string& glob,
+                                const std::string& tree_name,
+                                unsigned num_threads) {
+  File_ranges& cached = trees[tree_name];
+  File_ranges files = survey_files(glob, tree_name, cached, num_threads);
+  for (const auto& pair : files) {
+    auto it = cached.find(pair.first);
+    if (pair.second.scanned &&
+        (it == cached.end() || it->second.stamp != pair.second.stamp)) {
+      cached[pair.first] = pair.second;
+      changed = true;
+    }
+  }
+  return files;
+}
+
+bool range_cache::save() const {
+  if (!changed) {
+    return true;
+  }
+  // written next to the old one and renamed, so an interrupted write never
+  // leaves a truncated cache behind
+  std::string tmp_path = path + ".tmp";
+  std::ofstream os(tmp_path);
+  if (!os.good()) {
+    return false;
+  }
+  for (const auto& tree : trees) {
+    for (const auto& pair : tree.second) {
+      os << tree.first << '\t';
+      write_file_range(os, pair.second);
+      os << '\n';
+    }
+  }
+  os.close();
+  return os.good() && std::rename(tmp_path.c_str(), path.c_str()) == 0;
+}
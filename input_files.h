@@ -0,0 +1,107 @@
+#ifndef INPUT_FILES_H
+#define INPUT_FILES_H
+
+#include <ctime>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// size and modification time of one input file, used to detect changed inputs
+struct File_stamp {
+  std::string path;
+  long long size;
+  std::time_t mtime;
+
+  bool operator==(const File_stamp& other) const {
+    return path == other.path && size == other.size && mtime == other.mtime;
+  }
+  bool operator!=(const File_stamp& other) const { return !(*this == other); }
+};
+
+// smallest and largest run number found in one input file
+struct Run_range {
+  unsigned int min = 0;
+  unsigned int max = 0;
+  bool empty = true;
+
+  bool overlaps(const Run_range& other) const {
+    return !empty && !other.empty && min <= other.max && other.min <= max;
+  }
+};
+
+// run range plus smallest and largest event number of one input file
+struct Key_range {
+  Run_range runs;
+  unsigned long long min_event = 0;
+  unsigned long long max_event = 0;
+
+  // combos are reduced by event number across runs, so two files can only
+  // affect each other's matches if their event ranges overlap
+  bool events_overlap(const Key_range& other) const {
+    return !runs.empty && !other.runs.empty && min_event <= other.max_event &&
+           other.min_event <= max_event;
+  }
+};
+
+// stamp and key range of one input file. the stamp is taken before the scan,
+// so a file that changes while it is scanned is scanned again next time.
+struct File_range {
+  File_stamp stamp;
+  Key_range range;
+  bool scanned = false;  // false if the file could not be read
+};
+
+// the files of one glob, keyed (and so ordered) by path
+using File_ranges = std::map<std::string, File_range>;
+
+// expands a shell-style glob into a sorted list of paths. a pattern without
+// matches is returned unchanged so ROOT can report the missing file itself.
+std::vector<std::string> expand_glob(const std::string& pattern);
+
+// stats every path; unreadable files get size -1
+std::vector<File_stamp> stamp_files(const std::vector<std::string>& paths);
+
+// reads only the run and event branches of the file's tree. returns false if
+// the file could not be read.
+bool scan_key_range(const std::string& path, const std::string& tree_name,
+                    Key_range& range);
+
+// stamps every file matched by glob and collects its key range. ranges in
+// known are reused for files whose stamp did not change; the other files are
+// scanned on up to num_threads threads.
+File_ranges survey_files(const std::string& glob, const std::string& tree_name,
+                         const File_ranges& known, unsigned num_threads);
+
+// text form of a scanned file shared by the pre-scan cache and the
+// incremental manifest: FILE_RANGE_FIELDS tab-separated fields
+constexpr size_t FILE_RANGE_FIELDS = 8;
+std::vector<std::string> split_tabs(const std::string& line);
+void write_file_range(std::ostream& os, const File_range& file);
+// parses the fields starting at fields[first]; throws std::exception if they
+// are malformed
+File_range parse_file_range(const std::vector<std::string>& fields,
+                            size_t first);
+
+// file ranges of every tree a job reads, kept in a file between runs so only
+// new or changed files are scanned again
+class range_cache {
+ public:
+  // a missing or malformed cache file only costs a rescan
+  explicit range_cache(std::string path);
+
+  // survey_files() against the cached ranges of tree_name, which are then
+  // updated
+  File_ranges survey(const std::string& glob, const std::string& tree_name,
+                     unsigned num_threads);
+
+  // writes the cache if a survey scanned anything
+  bool save() const;
+
+ private:
+  std::string path;
+  std::map<std::string, File_ranges> trees;  // by tree name
+  bool changed = false;
+};
+
+#endif
@@ -0,0 +1,108 @@
+#include "io_tuning.h"
+
+#include <TBranch.h>
+#include <TEnv.h>
+#include <TFile.h>
+#include <TTree.h>
+#include <TTreeCache.h>
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <utility>
+
+using namespace std::chrono;
+
+io_options_scope::io_options_scope(const Io_options& io)
+    : previous_learn_entries(TTreeCache::GetLearnEntries()),
+      previous_async_prefetch(gEnv->GetValue("TFile.AsyncPrefetching", 0)) {
+  if (io.learn_entries > 0) {
+    TTreeCache::SetLearnEntries(io.learn_entries);
+  }
+  if (io.async_prefetch) {
+    gEnv->SetValue("TFile.AsyncPrefetching", 1);
+  }
+}
+
+io_options_scope::~io_options_scope() {
+  TTreeCache::SetLearnEntries(previous_learn_entries);
+  gEnv->SetValue("TFile.AsyncPrefetching", previous_async_prefetch);
+}
+
+void file_prefetcher::start(const std::string& path) {
+  wait();
+  worker = std::thread(&file_prefetcher::warm, this, path);
+}
+
+double file_prefetcher::wait() {
+  if (!worker.joinable()) {
+    return 0;
+  }
+  steady_clock::time_point t1 = steady_clock::now();
+  worker.join();
+  return duration_cast<duration<double>>(steady_clock::now() - t1).count();
+}
+
+void file_prefetcher::warm(const std::string& path) {
+  // baskets are read in file order, this many bytes per request at most
+  constexpr long long CHUNK_BYTES = 16 * 1024 * 1024;
+  try {
+    std::unique_ptr<TFile> file(TFile::Open(path.c_str()));
+    TTree* tree = nullptr;
+    if (!file || file->IsZombie()) {
+      return;
+    }
+    file->GetObject(tree_name.c_str(), tree);
+    if (!tree) {
+      return;
+    }
+
+    // position and compressed size of every basket on disk
+    std::vector<std::pair<Long64_t, Int_t>> baskets;
+    for (const std::string& name : branches) {
+      TBranch* branch = tree->GetBranch(name.c_str());
+      if (!branch) {
+        continue;
+      }
+      Long64_t* seeks = branch->GetBasketSeek();
+      Int_t* bytes = branch->GetBasketBytes();
+      for (Int_t i = 0; i < branch->GetWriteBasket(); i++) {
+        if (seeks[i] > 0 && bytes[i] > 0) {
+          baskets.push_back(std::make_pair(seeks[i], bytes[i]));
+        }
+      }
+    }
+    std::sort(baskets.begin(), baskets.end());
+
+    std::vector<char> buffer;
+    std::vector<Long64_t> positions;
+    std::vector<Int_t> lengths;
+    for (size_t first = 0; first < baskets.size();) {
+      positions.clear();
+      lengths.clear();
+      long long chunk = 0;
+      size_t last = first;
+      while (last < baskets.size() &&
+             (last == first || chunk + baskets[last].second <= CHUNK_BYTES)) {
+        positions.push_back(baskets[last].first);
+        lengths.push_back(baskets[last].second);
+        chunk += baskets[last].second;
+        last++;
+      }
+      buffer.resize(chunk);
+      // returns true on failure; the loader then reports the problem
+      if (file->ReadBuffers(buffer.data(), positions.data(), lengths.data(),
+                            positions.size())) {
+        break;
+      }
+      first = last;
+    }
+    bytes_read += file->GetBytesRead();
+  } catch (const std::exception& e) {
+    // the loader reads the file anyway and reports real problems
+    std::cout << "WARNING: Could not prefetch " << path << ": " << e.what()
+              << '\n';
+  }
+}
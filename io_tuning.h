@@ -0,0 +1,77 @@
+#ifndef IO_TUNING_H
+#define IO_TUNING_H
+
+#include <string>
+#include <thread>
+#include <vector>
+
+// read tuning for inputs on slow or shared storage. the defaults leave
+// ROOT's own settings alone.
+struct Io_options {
+  long long cache_size_mb = 0;  // TTreeCache per input tree, 0 = ROOT default
+  int learn_entries = 0;        // TTreeCache learning phase, 0 = ROOT default
+  bool async_prefetch = false;  // TTreeCache reads ahead on its own thread
+  bool prefetch_next = false;   // warm the next input file in the background
+
+  // tuned inputs are loaded file by file so reads can be measured
+  bool any() const {
+    return cache_size_mb > 0 || learn_entries > 0 || async_prefetch ||
+           prefetch_next;
+  }
+};
+
+// read volume and time of one tree's column loading
+struct Io_stats {
+  size_t files = 0;
+  long long bytes_read = 0;       // by the loader itself
+  long long read_calls = 0;
+  long long prefetch_bytes = 0;   // by the background prefetcher
+  double read_seconds = 0;        // spent in the loader's event loops
+  double wait_seconds = 0;        // spent waiting for the prefetcher
+};
+
+// sets the process-wide options (learning entries, async prefetching) for
+// the lifetime of one job and restores the previous values afterwards, so
+// the next job a server runs starts from ROOT's settings again. create it
+// before any input file is opened.
+class io_options_scope {
+ public:
+  explicit io_options_scope(const Io_options& io);
+  ~io_options_scope();
+
+  io_options_scope(const io_options_scope&) = delete;
+  io_options_scope& operator=(const io_options_scope&) = delete;
+
+ private:
+  int previous_learn_entries;
+  int previous_async_prefetch;
+};
+
+// warms one file at a time on a background thread: reads the compressed
+// baskets of the given branches of its tree straight from the file, without
+// unzipping them, so the loader later finds them in the OS page cache
+// instead of waiting on storage
+class file_prefetcher {
+ public:
+  file_prefetcher(std::string tree_name, std::vector<std::string> branches)
+      : tree_name(tree_name), branches(branches) {}
+  ~file_prefetcher() { wait(); }
+
+  // starts warming path. waits for the previous file first.
+  void start(const std::string& path);
+
+  // blocks until the current file is warm and returns the seconds waited
+  double wait();
+
+  long long get_bytes_read() const { return bytes_read; }
+
+ private:
+  void warm(const std::string& path);
+
+  std::string tree_name;
+  std::vector<std::string> branches;
+  std::thread worker;
+  long long bytes_read = 0;
+};
+
+#endif
@@ -0,0 +1,300 @@
+#include "job.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <set>
+
+#include "all_vs_all.h"
+#include "incremental.h"
+#include "prescan.h"
+#include "preview.h"
+#include "streaming.h"
+#include "tree_cache.h"
+
+using namespace std::chrono;
+
+bool read_job_config(const INIReader& reader, Job_config& config) {
+  // optional configs
+  config.out_file = reader.Get("Misc", "outfile", "placeholder");
+  config.best_by_beam = reader.GetBoolean("Misc", "best_per_beam", false);
+  config.preserve_combos = reader.GetBoolean("Misc", "preserve_combos", false);
+  config.logging = reader.GetBoolean("Misc", "logging", false);
+  config.compiled_output = reader.GetBoolean("Misc", "compiled_output", false);
+  config.rntuple_output = reader.GetBoolean("Misc", "rntuple_output", false);
+#ifndef CH_WITH_RNTUPLE
+  if (config.rntuple_output) {
+    std::cerr << "rntuple_output needs a build with RNTuple support. Rebuild "
+                 "with `make RNTUPLE=1`.\n";
+    return false;
+  }
+#endif
+  if (config.rntuple_output && config.compiled_output) {
+    std::cerr << "rntuple_output and compiled_output cannot be combined. "
+                 "rntuple_output already writes the compiled column set.\n";
+    return false;
+  }
+  config.incremental = reader.GetBoolean("Misc", "incremental", false);
+  config.all_vs_all = reader.GetBoolean("Misc", "all_vs_all", false);
+  if (config.incremental && config.all_vs_all) {
+    std::cerr << "incremental and all_vs_all cannot be combined.\n";
+    return false;
+  }
+  // every pair would write the same log_matches.txt at once
+  if (config.logging && config.all_vs_all) {
+    std::cerr << "logging cannot be combined with all_vs_all.\n";
+    return false;
+  }
+  config.streaming = reader.GetBoolean("Misc", "streaming", false);
+  if (config.streaming && (config.incremental || config.all_vs_all)) {
+    std::cerr << "streaming cannot be combined with incremental or "
+                 "all_vs_all.\n";
+    return false;
+  }
+  if (config.streaming && !config.best_by_beam) {
+    std::cerr << "streaming needs best_per_beam = true. The best overall "
+                 "combo mode reduces by event number across runs, which a "
+                 "single sorted pass cannot do.\n";
+    return false;
+  }
+  config.preview = reader.GetBoolean("Misc", "preview", false);
+  if (config.preview && (config.incremental || config.all_vs_all)) {
+    std::cerr << "preview cannot be combined with incremental or "
+                 "all_vs_all.\n";
+    return false;
+  }
+  // samples only apply to previews; full runs always read every entry
+  config.sample = Sample_config();
+  if (config.preview) {
+    config.sample.mode = Sample_mode::events;
+    std::string sample_mode = reader.Get("Misc", "sample_mode", "");
+    if (!sample_mode.empty() &&
+        !parse_sample_mode(sample_mode, config.sample.mode)) {
+      std::cerr << "Unknown sample_mode " << sample_mode
+                << ". Valid modes are entries, events and runs.\n";
+      return false;
+    }
+    config.sample.entries =
+        std::max(1L, reader.GetInteger("Misc", "sample_entries", 100000));
+    config.sample.fraction = reader.GetReal("Misc", "sample_fraction", 0.01);
+    if (config.sample.fraction <= 0 || config.sample.fraction > 1) {
+      std::cerr << "sample_fraction must be in (0, 1].\n";
+      return false;
+    }
+    config.sample.seed = reader.GetInteger("Misc", "sample_seed", 0);
+  }
+  config.prescan = reader.GetBoolean("Misc", "prescan", false);
+  // only the indexed path reads the pruned file lists
+  if (config.prescan && (config.streaming || config.preview ||
+                         config.incremental || config.all_vs_all)) {
+    std::cerr << "prescan cannot be combined with streaming, preview, "
+                 "incremental or all_vs_all.\n";
+    return false;
+  }
+  config.prescan_cache =
+      reader.Get("Misc", "prescan_cache", "input_ranges.cache");
+  config.io.cache_size_mb =
+      std::max(0L, reader.GetInteger("Misc", "tree_cache_mb", 0));
+  config.io.learn_entries =
+      std::max(0L, reader.GetInteger("Misc", "cache_learn_entries", 0));
+  config.io.async_prefetch = reader.GetBoolean("Misc", "async_prefetch", false);
+  config.io.prefetch_next =
+      reader.GetBoolean("Misc", "prefetch_next_file", false);
+  config.perf_counters = reader.GetBoolean("Misc", "perf_counters", false);
+  config.threads = std::max(1L, reader.GetInteger("Misc", "threads", 1));
+  config.preserve_order = reader.GetBoolean("Misc", "preserve_order", true);
+  config.encoding.compact = reader.GetBoolean("Misc", "compact_output", false);
+  config.encoding.mantissa_bits =
+      reader.GetInteger("Misc", "chisq_mantissa_bits", 10);
+  std::string bad_name;
+  if (!parse_derived_selection(reader.Get("Misc", "derived_columns", ""),
+                               config.derived, bad_name)) {
+    std::cerr << "Unknown derived column " << bad_name << ". Valid columns are "
+              << BEST_HYPOTHESIS_COLUMN << ", " << CHISQ_NDF_DELTA_COLUMN
+              << " and " << NUM_ALT_MATCHED_COLUMN << ".\n";
+    return false;
+  }
+
+  std::string tree1 = reader.Get("1", "tree", "");
+  std::string glob1 = reader.Get("1", "glob", "");
+  if (glob1.empty() || tree1.empty()) {
+    std::cerr << "Primary hypothesis parameters missing. Please enter the primary hypotheses' filename and treename in the config.\n";
+    return false;
+  }
+  config.primary = {glob1, tree1};
+
+  // get number of alternative hypotheses
+  int num_alt_hypos = reader.GetInteger("1", "num_alt_hypos", 1);
+  config.alt_hypos.clear();
+  config.alt_hypos.reserve(num_alt_hypos);
+  for (int i = 0; i < num_alt_hypos; i++) {
+    std::string num_as_string = std::to_string(i+2);
+    std::string glob = reader.Get(num_as_string, "glob", "");
+    std::string tree = reader.Get(num_as_string, "tree", "");
+
+    if (glob.empty() || tree.empty()) {
+      std::cerr << "At least one alternative hypothesis parameter is missing. Please ensure you entered the filenames' glob and treenames for the number of hypotheses you indicated in the config.\n";
+      return false;
+    }
+
+    config.alt_hypos.push_back({glob, tree});
+  }
+
+  // tree names label the output files and branches of all-vs-all runs
+  if (config.all_vs_all) {
+    std::set<std::string> tree_names = {config.primary.treename};
+    for (const Tree_config& tree : config.alt_hypos) {
+      if (!tree_names.insert(tree.treename).second) {
+        std::cerr << "all_vs_all needs a distinct tree name per hypothesis, "
+                  << tree.treename << " is used more than once.\n";
+        return false;
+      }
+    }
+  }
+
+  std::string encoding_problem =
+      encoding_error(config.encoding, config.alt_hypos.size());
+  if (!encoding_problem.empty()) {
+    std::cerr << encoding_problem << '\n';
+    return false;
+  }
+  return true;
+}
+
+std::unique_ptr<compare_hypotheses> make_comparison(const Job_config& config,
+                                                    tree_cache* cache) {
+  std::unique_ptr<compare_hypotheses> c;
+  if (cache) {
+    if (config.prescan) {
+      std::cout << "WARNING: prescan is not applied in server mode, where "
+                   "trees are kept loaded by glob.\n";
+    }
+    std::vector<std::shared_ptr<hypothesis_tree_base>> alts;
+    for (const Tree_config& tree : config.alt_hypos) {
+      alts.push_back(
+          cache->get(tree.filename, tree.treename, config.best_by_beam));
+    }
+    c.reset(new compare_hypotheses(
+        cache->get(config.primary.filename, config.primary.treename,
+                   config.best_by_beam),
+        alts, config.best_by_beam));
+  } else if (config.prescan) {
+    // cached trees stay keyed by glob, so pruning only applies here
+    Prescan_result files = prescan_inputs(config);
+    std::vector<std::shared_ptr<hypothesis_tree_base>> alts;
+    for (size_t i = 0; i < config.alt_hypos.size(); i++) {
+      alts.push_back(make_hypothesis_tree(
+          files.alts[i], config.alt_hypos[i].treename, config.best_by_beam));
+    }
+    c.reset(new compare_hypotheses(
+        make_hypothesis_tree(files.primary, config.primary.treename,
+                             config.best_by_beam),
+        alts, config.best_by_beam));
+  } else {
+    c.reset(new compare_hypotheses(config.primary.filename,
+                                   config.primary.treename, config.alt_hypos,
+                                   config.best_by_beam));
+  }
+  apply_options(*c, config);
+  return c;
+}
+
+void apply_options(compare_hypotheses& c, const Job_config& config) {
+  c.set_preserving(config.preserve_combos);
+  c.set_logging(config.logging);
+  c.set_compiled_output(config.compiled_output);
+  c.set_rntuple_output(config.rntuple_output);
+  c.set_threads(config.threads);
+  c.set_preserve_order(config.preserve_order);
+  c.set_encoding(config.encoding);
+  c.set_derived(config.derived);
+  c.set_io(config.io);
+  c.set_perf_counters(config.perf_counters);
+  c.set_match_by_beam(config.best_by_beam);
+}
+
+int run_job(const Job_config& config, tree_cache* cache) {
+  io_options_scope io_scope(config.io);
+  if (config.incremental) {
+    return run_incremental_job(config);
+  }
+  if (config.all_vs_all) {
+    return run_all_vs_all_job(config, cache);
+  }
+  if (config.preview) {
+    return run_preview_job(config);
+  }
+
+  // init benchmarking
+  high_resolution_clock::time_point t1 = high_resolution_clock::now();
+
+  if (config.best_by_beam) {
+    std::cout << "Running in best combo per beam ID mode.\n";
+  } else {
+    std::cout << "Running in best overall combo mode.\n";
+  }
+
+  std::cout << "Comparing:\n";
+  for (const Tree_config& tree : config.alt_hypos) {
+    std::cout << config.primary.treename + " with " + tree.treename + '\n';
+  }
+
+  if (config.streaming) {
+    if (config.rntuple_output) {
+      std::cout << "WARNING: streaming mode writes TTrees only, using the "
+                   "indexed path for RNTuple output.\n";
+    } else if (config.logging) {
+      std::cout << "WARNING: streaming mode does not log matches, using the "
+                   "indexed path.\n";
+    } else {
+      std::string out_file = config.out_file;
+      if (out_file == "placeholder" || out_file == "") {
+        out_file = std::to_string(config.alt_hypos.size()) +
+                   "_hypothesesMatched.root";
+      }
+      std::cout << "Streaming sorted input..." << std::endl;
+      unsigned long long matches = 0;
+      Streaming_status status = run_streaming_job(config, out_file, matches);
+      if (status == Streaming_status::failed) {
+        return 1;
+      }
+      if (status == Streaming_status::done) {
+        std::cout << "Number of matches: " << matches << std::endl;
+        high_resolution_clock::time_point t2 = high_resolution_clock::now();
+        auto duration = duration_cast<microseconds>(t2 - t1).count();
+        std::cout << "The streaming pass took: " << duration * 1E-6
+                  << " seconds\n";
+        return 0;
+      }
+      std::cout << "Input is not sorted by run and event, falling back to "
+                   "the indexed path.\n";
+    }
+  }
+
+  std::cout << "Pre-processing data..." << std::endl;
+  std::unique_ptr<compare_hypotheses> c = make_comparison(config, cache);
+
+  c->prepare_data();
+  std::cout << "Data prepared, finding matches..." << std::endl;
+  c->find_matches();
+
+  std::cout << "Number of matches: " << c->matches << std::endl;
+
+  // benchmark the matching process
+  high_resolution_clock::time_point t2 = high_resolution_clock::now();
+  auto matching_duration = duration_cast<microseconds>( t2 - t1 ).count();
+  std::cout << "The matching process took: " << matching_duration*1E-6 << " seconds\n";
+
+  std::cout << "Writing to file...\n";
+  if (!c->write_to_file(config.out_file)) {
+    std::cerr << "Error: The output was not written.\n";
+    return 1;
+  }
+
+  // benchmark the writing-to-file
+  high_resolution_clock::time_point t3 = high_resolution_clock::now();
+  auto writeDuration = duration_cast<microseconds>( t3 - t2 ).count();
+  std::cout << "The file-writing process took: " << writeDuration*1E-6 << " seconds\n";
+
+  return 0;
+}
@@ -0,0 +1,55 @@
+#ifndef JOB_H
+#define JOB_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "compare_hypotheses.h"
+#include "inih/INIReader.h"
+
+class tree_cache;
+
+// everything a single comparison needs, as read from a config.ini
+struct Job_config {
+  Tree_config primary;
+  std::vector<Tree_config> alt_hypos;
+
+  std::string out_file = "placeholder";
+  bool best_by_beam = false;
+  bool preserve_combos = false;
+  bool logging = false;
+  bool compiled_output = false;
+  bool rntuple_output = false;
+  bool incremental = false;  // only reprocess inputs changed since last run
+  unsigned threads = 1;
+  bool preserve_order = true;
+  Output_encoding encoding;
+  Derived_selection derived;
+  bool all_vs_all = false;  // compare every hypothesis with all the others
+  bool streaming = false;  // one sorted pass instead of materialized columns
+  bool preview = false;  // match a sample and report rates, write nothing
+  Sample_config sample;
+  bool prescan = false;  // skip alternative files sharing no runs/events
+  std::string prescan_cache = "input_ranges.cache";
+  Io_options io;
+  bool perf_counters = false;  // print per-phase CPU counters
+};
+
+// fills config from the parsed INI. prints the problem and returns false if a
+// required parameter is missing.
+bool read_job_config(const INIReader& reader, Job_config& config);
+
+// builds the comparison described by config with all its options applied. if
+// cache is given, trees are taken from (and kept in) it.
+std::unique_ptr<compare_hypotheses> make_comparison(const Job_config& config,
+                                                    tree_cache* cache = nullptr);
+
+// copies the output and matching options of config onto c
+void apply_options(compare_hypotheses& c, const Job_config& config);
+
+// prepares, matches and writes one comparison. if cache is given, trees are
+// taken from (and kept in) it instead of being loaded from scratch.
+int run_job(const Job_config& config, tree_cache* cache = nullptr);
+
+#endif
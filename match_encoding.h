@@ -0,0 +1,81 @@
+#ifndef MATCH_ENCODING_H
+#define MATCH_ENCODING_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include <ROOT/RVec.hxx>
+
+// chisq/ndf written for primary entries without a match in a hypothesis
+constexpr float NO_MATCH_INDICATOR = 185100000.0f;
+
+// compact output encoding: a match_mask with one bit per alternative
+// hypothesis, and chisq/ndf stored with a reduced mantissa (0 where
+// unmatched) instead of a full float holding NO_MATCH_INDICATOR
+
+constexpr const char* MATCH_MASK_COLUMN = "match_mask";
+constexpr unsigned MAX_MASK_HYPOS = 32;
+
+// mantissa bits a Float16_t branch can hold
+constexpr int MIN_MANTISSA_BITS = 2;
+constexpr int MAX_MANTISSA_BITS = 16;
+
+struct Output_encoding {
+  bool compact = false;
+  int mantissa_bits = 10;  // of float's 23; 10 matches IEEE half precision
+};
+
+// empty if every writer can write the encoding for num_hypos alternative
+// hypotheses, otherwise the reason it cannot
+inline std::string encoding_error(const Output_encoding& encoding,
+                                  size_t num_hypos) {
+  if (encoding.mantissa_bits < MIN_MANTISSA_BITS ||
+      encoding.mantissa_bits > MAX_MANTISSA_BITS) {
+    return "chisq_mantissa_bits must be between " +
+           std::to_string(MIN_MANTISSA_BITS) + " and " +
+           std::to_string(MAX_MANTISSA_BITS) + ".";
+  }
+  if (encoding.compact && num_hypos > MAX_MASK_HYPOS) {
+    return "compact_output supports at most " +
+           std::to_string(MAX_MASK_HYPOS) + " alternative hypotheses.";
+  }
+  return "";
+}
+
+// rounds value to the given number of mantissa bits, which must be between
+// MIN_MANTISSA_BITS and MAX_MANTISSA_BITS. the dropped low bits become zeros,
+// which the file compression then mostly removes.
+inline float truncate_mantissa(float value, int bits) {
+  int drop = 23 - bits;
+  if (drop <= 0) {
+    return value;
+  }
+  std::uint32_t raw;
+  std::memcpy(&raw, &value, sizeof(raw));
+  raw += std::uint32_t(1) << (drop - 1);
+  raw &= ~((std::uint32_t(1) << drop) - 1);
+  std::memcpy(&value, &raw, sizeof(value));
+  return value;
+}
+
+inline float encode_chisq_ndf(float value, const Output_encoding& encoding) {
+  if (!encoding.compact) {
+    return value;
+  }
+  return value == NO_MATCH_INDICATOR
+             ? 0.0f
+             : truncate_mantissa(value, encoding.mantissa_bits);
+}
+
+inline unsigned int match_mask(const ROOT::RVec<float>& values) {
+  unsigned int mask = 0;
+  for (size_t i = 0; i < values.size() && i < MAX_MASK_HYPOS; i++) {
+    if (values[i] != NO_MATCH_INDICATOR) {
+      mask |= 1u << i;
+    }
+  }
+  return mask;
+}
+
+#endif
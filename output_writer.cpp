@@ -0,0 +1,220 @@
+#include "output_writer.h"
+
+#include <RVersion.h>
+#include <TFile.h>
+#include <TTree.h>
+
+#include <exception>
+#include <iostream>
+#include <memory>
+
+#include "compare_hypotheses.h"
+#include "compiled_columns.h"
+
+#ifdef CH_WITH_RNTUPLE
+// RNTuple left ROOT::Experimental and got its own writer header over time
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6, 36, 0)
+#include <ROOT/RNTupleModel.hxx>
+#include <ROOT/RNTupleWriter.hxx>
+namespace rntuple = ROOT;
+#elif ROOT_VERSION_CODE >= ROOT_VERSION(6, 32, 0)
+#include <ROOT/RNTupleModel.hxx>
+#include <ROOT/RNTupleWriter.hxx>
+namespace rntuple = ROOT::Experimental;
+#else
+#include <ROOT/RNTuple.hxx>
+#include <ROOT/RNTupleModel.hxx>
+namespace rntuple = ROOT::Experimental;
+#endif
+#endif
+
+#define COMPILED_COLUMN_MEMBER(type, name) type name;
+#define COMPILED_COLUMN_PARAM(type, name) , type name
+#define COMPILED_COLUMN_NAME(type, name) , #name
+#define COMPILED_COLUMN_BRANCH(type, name) tree->Branch(#name, &extra.name);
+#define COMPILED_COLUMN_COPY(type, name) extra.name = name;
+#define COMPILED_COLUMN_FIELD(type, name) \
+  auto name##_field = model->MakeField<type>(#name);
+#define COMPILED_COLUMN_FIELD_COPY(type, name) *name##_field = name;
+
+bool write_compiled_tree(ROOT::RDF::RNode node, const std::string& out_file,
+                         const Output_layout& layout) {
+  const std::vector<std::string>& hypo_branches = layout.hypo_branches;
+  const Output_encoding& encoding = layout.encoding;
+  std::unique_ptr<TFile> file(TFile::Open(out_file.c_str(), "RECREATE"));
+  if (!file || file->IsZombie()) {
+    std::cerr << "Error: Could not open output file " << out_file << '\n';
+    return false;
+  }
+  // owned by the file
+  TTree* tree = new TTree("hypothesesMatched", "hypothesesMatched");
+
+  unsigned long long event;
+  unsigned int run;
+  unsigned int beam;
+  float chisq;
+  unsigned ndf;
+  tree->Branch("event", &event);
+  tree->Branch("run", &run);
+  tree->Branch("beam_beamid", &beam);
+  tree->Branch("kin_chisq", &chisq);
+  tree->Branch("kin_ndf", &ndf);
+
+  struct {
+    COMPILED_EXTRA_COLUMNS(COMPILED_COLUMN_MEMBER)
+  } extra;
+  (void)extra;  // unused while COMPILED_EXTRA_COLUMNS is empty
+  COMPILED_EXTRA_COLUMNS(COMPILED_COLUMN_BRANCH)
+
+  std::vector<float> hypo_values(hypo_branches.size());
+  unsigned int mask = 0;
+  if (encoding.compact) {
+    // Float16_t with range [0,0] keeps the exponent and truncates the
+    // mantissa to the given bits on disk
+    for (size_t i = 0; i < hypo_branches.size(); i++) {
+      std::string leaf = hypo_branches[i] + "/f[0,0," +
+                         std::to_string(encoding.mantissa_bits) + "]";
+      tree->Branch(hypo_branches[i].c_str(), &hypo_values[i], leaf.c_str());
+    }
+    tree->Branch(MATCH_MASK_COLUMN, &mask);
+  } else {
+    for (size_t i = 0; i < hypo_branches.size(); i++) {
+      tree->Branch(hypo_branches[i].c_str(), &hypo_values[i]);
+    }
+  }
+
+  Derived_values derived;
+  if (layout.derived.best_hypothesis) {
+    tree->Branch(BEST_HYPOTHESIS_COLUMN, &derived.best_hypothesis);
+  }
+  if (layout.derived.chisq_ndf_delta) {
+    tree->Branch(CHISQ_NDF_DELTA_COLUMN, &derived.chisq_ndf_delta);
+  }
+  if (layout.derived.num_alt_matched) {
+    tree->Branch(NUM_ALT_MATCHED_COLUMN, &derived.num_alt_matched);
+  }
+
+  node.Foreach(
+      [&](unsigned long long e, unsigned int r, unsigned int b, float c,
+          unsigned n,
+          const ROOT::RVec<float>& values
+              COMPILED_EXTRA_COLUMNS(COMPILED_COLUMN_PARAM)) {
+        event = e;
+        run = r;
+        beam = b;
+        chisq = c;
+        ndf = n;
+        COMPILED_EXTRA_COLUMNS(COMPILED_COLUMN_COPY)
+        for (size_t i = 0; i < hypo_values.size(); i++) {
+          hypo_values[i] = encode_chisq_ndf(values[i], encoding);
+        }
+        mask = match_mask(values);
+        if (layout.derived.any()) {
+          derived = compute_derived(c, n, values, encoding);
+        }
+        tree->Fill();
+      },
+      {"event", "run", "beam_beamid", "kin_chisq", "kin_ndf",
+       HYPOS_COLUMN COMPILED_EXTRA_COLUMNS(COMPILED_COLUMN_NAME)});
+
+  if (file->Write() <= 0) {
+    std::cerr << "Error: Could not write output file " << out_file << '\n';
+    return false;
+  }
+  file->Close();
+  return true;
+}
+
+#ifdef CH_WITH_RNTUPLE
+bool write_rntuple(ROOT::RDF::RNode node, const std::string& out_file,
+                   const Output_layout& layout) {
+  auto model = rntuple::RNTupleModel::Create();
+  auto event = model->MakeField<unsigned long long>("event");
+  auto run = model->MakeField<unsigned int>("run");
+  auto beam = model->MakeField<unsigned int>("beam_beamid");
+  auto chisq = model->MakeField<float>("kin_chisq");
+  auto ndf = model->MakeField<unsigned>("kin_ndf");
+  COMPILED_EXTRA_COLUMNS(COMPILED_COLUMN_FIELD)
+
+  std::vector<std::shared_ptr<float>> hypo_fields;
+  for (const std::string& name : layout.hypo_branches) {
+    hypo_fields.push_back(model->MakeField<float>(name));
+  }
+  std::shared_ptr<unsigned int> mask;
+  if (layout.encoding.compact) {
+    mask = model->MakeField<unsigned int>(MATCH_MASK_COLUMN);
+  }
+  std::shared_ptr<int> best_hypothesis;
+  std::shared_ptr<float> chisq_ndf_delta;
+  std::shared_ptr<unsigned int> num_alt_matched;
+  if (layout.derived.best_hypothesis) {
+    best_hypothesis = model->MakeField<int>(BEST_HYPOTHESIS_COLUMN);
+  }
+  if (layout.derived.chisq_ndf_delta) {
+    chisq_ndf_delta = model->MakeField<float>(CHISQ_NDF_DELTA_COLUMN);
+  }
+  if (layout.derived.num_alt_matched) {
+    num_alt_matched = model->MakeField<unsigned int>(NUM_ALT_MATCHED_COLUMN);
+  }
+
+  // the RNTuple writer reports I/O errors by throwing
+  try {
+    auto writer = rntuple::RNTupleWriter::Recreate(
+        std::move(model), "hypothesesMatched", out_file);
+
+    node.Foreach(
+        [&](unsigned long long e, unsigned int r, unsigned int b, float c,
+            unsigned n,
+            const ROOT::RVec<float>& values
+                COMPILED_EXTRA_COLUMNS(COMPILED_COLUMN_PARAM)) {
+          *event = e;
+          *run = r;
+          *beam = b;
+          *chisq = c;
+          *ndf = n;
+          COMPILED_EXTRA_COLUMNS(COMPILED_COLUMN_FIELD_COPY)
+          for (size_t i = 0; i < hypo_fields.size(); i++) {
+            *hypo_fields[i] = encode_chisq_ndf(values[i], layout.encoding);
+          }
+          if (mask) {
+            *mask = match_mask(values);
+          }
+          if (layout.derived.any()) {
+            Derived_values derived =
+                compute_derived(c, n, values, layout.encoding);
+            if (best_hypothesis) {
+              *best_hypothesis = derived.best_hypothesis;
+            }
+            if (chisq_ndf_delta) {
+              *chisq_ndf_delta = derived.chisq_ndf_delta;
+            }
+            if (num_alt_matched) {
+              *num_alt_matched = derived.num_alt_matched;
+            }
+          }
+          writer->Fill();
+        },
+        {"event", "run", "beam_beamid", "kin_chisq", "kin_ndf",
+         HYPOS_COLUMN COMPILED_EXTRA_COLUMNS(COMPILED_COLUMN_NAME)});
+
+    // commit explicitly: the writer's destructor only logs a failed commit.
+    // older ROOT versions can only commit there
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6, 32, 0)
+    writer->CommitDataset();
+#endif
+    writer.reset();
+  } catch (const std::exception& e) {
+    std::cerr << "Error: Could not write output file " << out_file << ": "
+              << e.what() << '\n';
+    return false;
+  }
+  return true;
+}
+#else
+bool write_rntuple(ROOT::RDF::RNode, const std::string&,
+                   const Output_layout&) {
+  std::cerr << "Error: RNTuple output requested, but this build has no "
+               "RNTuple support. Rebuild with `make RNTUPLE=1`.\n";
+  return false;
+}
+#endif
@@ -0,0 +1,36 @@
+#ifndef OUTPUT_WRITER_H
+#define OUTPUT_WRITER_H
+
+#include <string>
+#include <vector>
+
+#include <ROOT/RDataFrame.hxx>
+
+#include "derived_columns.h"
+#include "match_encoding.h"
+
+// the columns a writer adds to the primary entries
+struct Output_layout {
+  std::vector<std::string> hypo_branches;  // one per alternative hypothesis
+  Output_encoding encoding;
+  Derived_selection derived;
+};
+
+// writes the filtered primary entries into a TTree without going through the
+// untyped Snapshot, so no column readers are JIT-compiled. the column set is
+// fixed at build time: the five key columns, COMPILED_EXTRA_COLUMNS, and one
+// float branch per hypothesis filled from the dense HYPOS_COLUMN. with the
+// compact encoding the hypothesis branches become Float16_t with the chosen
+// mantissa bits, plus a match_mask branch. selected derived columns are
+// computed in the same loop. returns false if the output file could not be
+// written.
+bool write_compiled_tree(ROOT::RDF::RNode node, const std::string& out_file,
+                         const Output_layout& layout);
+
+// same column set as write_compiled_tree, written as an RNTuple named
+// hypothesesMatched. only available when built with RNTUPLE=1; returns false
+// (and writes nothing) otherwise.
+bool write_rntuple(ROOT::RDF::RNode node, const std::string& out_file,
+                   const Output_layout& layout);
+
+#endif
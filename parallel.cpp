@@ -0,0 +1,47 @@
+#include "parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+void parallel_for(size_t n, unsigned num_threads,
+                  const std::function<void(size_t)>& task) {
+  size_t num_workers = std::min<size_t>(std::max(num_threads, 1u), n);
+  if (num_workers <= 1) {
+    for (size_t i = 0; i < n; i++) {
+      task(i);
+    }
+    return;
+  }
+
+  std::atomic<size_t> next(0);
+  std::mutex error_mutex;
+  std::exception_ptr error;
+  auto worker = [&]() {
+    size_t i;
+    while ((i = next++) < n) {
+      try {
+        task(i);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        if (!error) {
+          error = std::current_exception();
+        }
+      }
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (size_t t = 0; t < num_workers; t++) {
+    workers.emplace_back(worker);
+  }
+  for (std::thread& t : workers) {
+    t.join();
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
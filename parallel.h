@@ -0,0 +1,14 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <cstddef>
+#include <functional>
+
+// runs task(i) for every i in [0, n) on up to num_threads threads, in index
+// order per thread. the first exception thrown by a task is rethrown once
+// all threads are done. callers running ROOT I/O in tasks must call
+// ROOT::EnableThreadSafety() first.
+void parallel_for(size_t n, unsigned num_threads,
+                  const std::function<void(size_t)>& task);
+
+#endif
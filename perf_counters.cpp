@@ -0,0 +1,177 @@
+#include "perf_counters.h"
+
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstring>
+#endif
+
+namespace {
+
+#ifdef __linux__
+struct Counter_config {
+  unsigned type;
+  unsigned long long config;
+};
+
+// in the order of Perf_sample's fields
+const Counter_config COUNTERS[] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+};
+
+// counters are opened separately, not as a group, because grouped reads
+// cannot include inherited counts of worker threads. so the kernel may
+// multiplex them when there are fewer hardware counters than events; each
+// read reports how long the counter was enabled and running to scale by.
+int open_counter(const Counter_config& counter) {
+  perf_event_attr attr;
+  std::memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = counter.type;
+  attr.config = counter.config;
+  attr.disabled = 1;
+  attr.inherit = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format =
+      PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  return static_cast<int>(
+      syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+// the layout read() returns for the read_format above
+struct Counter_reading {
+  unsigned long long value;
+  unsigned long long time_enabled;
+  unsigned long long time_running;
+};
+
+// estimates the count over the whole phase from the time the counter ran
+unsigned long long scaled_value(const Counter_reading& reading,
+                                bool& multiplexed) {
+  if (reading.time_running >= reading.time_enabled) {
+    return reading.value;
+  }
+  multiplexed = true;
+  if (reading.time_running == 0) {
+    return 0;
+  }
+  return static_cast<unsigned long long>(
+      static_cast<double>(reading.value) * reading.time_enabled /
+      reading.time_running);
+}
+#endif
+
+void warn_unavailable() {
+  static bool warned = false;
+  if (!warned) {
+    warned = true;
+    std::cout << "WARNING: perf counters are unavailable. On Linux, check "
+                 "that kernel.perf_event_paranoid is at most 2.\n";
+  }
+}
+
+}  // namespace
+
+perf_phase::perf_phase(bool enabled, std::string name, size_t entries)
+    : name(name), entries(entries) {
+  for (int& fd : fds) {
+    fd = -1;
+  }
+  if (!enabled) {
+    return;
+  }
+#ifdef __linux__
+  for (int i = 0; i < NUM_COUNTERS; i++) {
+    fds[i] = open_counter(COUNTERS[i]);
+    if (fds[i] < 0) {
+      // hardware counters are often missing in VMs; page faults still work
+      continue;
+    }
+    counting = true;
+  }
+  if (!counting) {
+    warn_unavailable();
+    return;
+  }
+  for (int fd : fds) {
+    if (fd >= 0) {
+      ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+      ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+#else
+  warn_unavailable();
+#endif
+}
+
+perf_phase::~perf_phase() {
+#ifdef __linux__
+  if (!counting) {
+    return;
+  }
+  Perf_sample sample;
+  unsigned long long values[NUM_COUNTERS] = {0, 0, 0, 0, 0};
+  for (int i = 0; i < NUM_COUNTERS; i++) {
+    if (fds[i] < 0) {
+      continue;
+    }
+    ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+    Counter_reading reading;
+    if (read(fds[i], &reading, sizeof(reading)) == sizeof(reading)) {
+      values[i] = scaled_value(reading, sample.multiplexed);
+    }
+    close(fds[i]);
+  }
+  sample.hardware = fds[0] >= 0 && fds[1] >= 0 && fds[2] >= 0 && fds[3] >= 0;
+  sample.software = fds[4] >= 0;
+  sample.cycles = values[0];
+  sample.instructions = values[1];
+  sample.cache_misses = values[2];
+  sample.branch_misses = values[3];
+  sample.page_faults = values[4];
+  print_perf_sample(name, sample, entries);
+#endif
+}
+
+void print_perf_sample(const std::string& name, const Perf_sample& sample,
+                       size_t entries) {
+  if (!sample.hardware && !sample.software) {
+    return;
+  }
+  double n = entries ? static_cast<double>(entries) : 1.0;
+  std::ostringstream os;
+  os << std::fixed << std::setprecision(2) << "perf " << name << ": ";
+  if (sample.hardware) {
+    os << "IPC "
+       << (sample.cycles ? static_cast<double>(sample.instructions) /
+                               sample.cycles
+                         : 0.0)
+       << ", " << sample.cycles / 1e6 << " Mcycles, "
+       << sample.cache_misses / n << " cache misses/entry, "
+       << sample.branch_misses / n << " branch misses/entry, ";
+  } else {
+    os << "no hardware counters, ";
+  }
+  if (sample.software) {
+    os << sample.page_faults / n << " page faults/entry ";
+  }
+  os << '(' << entries << " entries";
+  if (sample.multiplexed) {
+    os << ", multiplexed: counts scaled from partial run time";
+  }
+  os << ")\n";
+  // one write so phases of parallel threads do not interleave
+  std::cout << os.str();
+}
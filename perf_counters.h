@@ -0,0 +1,44 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <string>
+
+// hardware and software counters of one phase, counted for the calling
+// thread and the threads it starts while counting
+struct Perf_sample {
+  bool hardware = false;  // cycles to branch misses were counted
+  bool software = false;  // page faults were counted
+  // some counters shared the hardware with other events; their values are
+  // scaled up from the time they actually ran
+  bool multiplexed = false;
+  unsigned long long cycles = 0;
+  unsigned long long instructions = 0;
+  unsigned long long cache_misses = 0;
+  unsigned long long branch_misses = 0;
+  unsigned long long page_faults = 0;
+};
+
+// counts a phase from construction to destruction through perf_event_open
+// and prints its IPC and misses per entry. does nothing unless enabled, and
+// prints a warning instead where the counters are unavailable (non-Linux, or
+// restricted by kernel.perf_event_paranoid).
+class perf_phase {
+ public:
+  perf_phase(bool enabled, std::string name, size_t entries);
+  ~perf_phase();
+
+  perf_phase(const perf_phase&) = delete;
+  perf_phase& operator=(const perf_phase&) = delete;
+
+ private:
+  enum { NUM_COUNTERS = 5 };
+  std::string name;
+  size_t entries;
+  int fds[NUM_COUNTERS];
+  bool counting = false;
+};
+
+void print_perf_sample(const std::string& name, const Perf_sample& sample,
+                       size_t entries);
+
+#endif
@@ -0,0 +1,45 @@
+#include "prescan.h"
+
+#include <iostream>
+
+#include "input_files.h"
+
+Prescan_result prescan_inputs(const Job_config& config) {
+  std::vector<Tree_config> hypos = {config.primary};
+  hypos.insert(hypos.end(), config.alt_hypos.begin(), config.alt_hypos.end());
+
+  range_cache cache(config.prescan_cache);
+  std::vector<File_ranges> files;
+  for (const Tree_config& hypo : hypos) {
+    files.push_back(cache.survey(hypo.filename, hypo.treename, config.threads));
+  }
+  if (!cache.save()) {
+    std::cout << "WARNING: Could not write the pre-scan cache "
+              << config.prescan_cache << ".\n";
+  }
+
+  // every primary file is kept. alternative files are kept if their events
+  // overlap a primary file's, or if they could not be scanned so ROOT
+  // reports them.
+  Prescan_result result;
+  for (const auto& pair : files[0]) {
+    result.primary.push_back(pair.first);
+  }
+  for (size_t h = 1; h < hypos.size(); h++) {
+    std::vector<std::string> kept;
+    for (const auto& alt : files[h]) {
+      bool keep = !alt.second.scanned;
+      for (auto p = files[0].begin(); !keep && p != files[0].end(); ++p) {
+        keep = !p->second.scanned ||
+               alt.second.range.events_overlap(p->second.range);
+      }
+      if (keep) {
+        kept.push_back(alt.first);
+      }
+    }
+    std::cout << "Pre-scan: reading " << kept.size() << " of "
+              << files[h].size() << " files of " << hypos[h].treename << '\n';
+    result.alts.push_back(kept);
+  }
+  return result;
+}
@@ -0,0 +1,23 @@
+#ifndef PRESCAN_H
+#define PRESCAN_H
+
+#include <string>
+#include <vector>
+
+#include "job.h"
+
+// input files left after the pre-scan, in glob order
+struct Prescan_result {
+  std::vector<std::string> primary;
+  std::vector<std::vector<std::string>> alts;  // one list per alt hypothesis
+};
+
+// collects the event range of every input file and drops the alternative
+// files whose events overlap no primary file's, before any event loop is
+// built. runs are not compared: combos are reduced by event number across
+// runs, so a file from another run can still change which combo is kept.
+// ranges are kept in a range_cache at config.prescan_cache, so only new or
+// changed files are read again.
+Prescan_result prescan_inputs(const Job_config& config);
+
+#endif
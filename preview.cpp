@@ -0,0 +1,130 @@
+#include "preview.h"
+
+#include <TROOT.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+#include "parallel.h"
+
+using namespace std::chrono;
+
+namespace {
+
+const char* mode_name(Sample_mode mode) {
+  switch (mode) {
+    case Sample_mode::entries:
+      return "entries";
+    case Sample_mode::events:
+      return "events";
+    case Sample_mode::runs:
+      return "runs";
+    case Sample_mode::none:
+      break;
+  }
+  return "none";
+}
+
+// prints the 10%, 50% and 90% quantiles of values, which is reordered
+void print_quantiles(std::vector<float>& values) {
+  if (values.empty()) {
+    std::cout << "n/a";
+    return;
+  }
+  const double quantiles[] = {0.1, 0.5, 0.9};
+  for (size_t q = 0; q < 3; q++) {
+    size_t k = static_cast<size_t>(quantiles[q] * (values.size() - 1));
+    std::nth_element(values.begin(), values.begin() + k, values.end());
+    std::cout << (q ? " / " : "") << values[k];
+  }
+}
+
+}  // namespace
+
+int run_preview_job(const Job_config& config) {
+  high_resolution_clock::time_point t1 = high_resolution_clock::now();
+  const Sample_config& sample = config.sample;
+
+  std::cout << "Previewing a sample of ";
+  if (sample.mode == Sample_mode::entries) {
+    std::cout << "the first " << sample.entries << " entries per tree";
+  } else {
+    std::cout << sample.fraction * 100 << "% of " << mode_name(sample.mode);
+  }
+  std::cout << ". No output is written." << std::endl;
+
+  ROOT::EnableThreadSafety();
+
+  std::vector<Tree_config> hypos = {config.primary};
+  hypos.insert(hypos.end(), config.alt_hypos.begin(), config.alt_hypos.end());
+  std::vector<std::shared_ptr<hypothesis_tree_base>> trees;
+  for (const Tree_config& hypo : hypos) {
+    trees.push_back(make_hypothesis_tree(hypo.filename, hypo.treename,
+                                         config.best_by_beam));
+    trees.back()->set_sample(sample);
+    trees.back()->set_io(config.io);
+  }
+  parallel_for(trees.size(), config.threads,
+               [&trees](size_t i) { trees[i]->prepare(); });
+
+  std::vector<std::shared_ptr<hypothesis_tree_base>> alts(trees.begin() + 1,
+                                                          trees.end());
+  compare_hypotheses c(trees[0], alts, config.best_by_beam);
+  c.find_matches();
+
+  // reduced primary combos and their chisq/ndf
+  const hypothesis_tree_base& primary = *trees[0];
+  std::vector<float> primary_values;
+  if (config.best_by_beam) {
+    for (const auto& pair : primary.event_beam_as_key_map) {
+      primary_values.push_back(pair.second.get_chi_sq() /
+                               pair.second.get_ndf());
+    }
+  } else {
+    for (const auto& pair : primary.event_as_key_map) {
+      primary_values.push_back(pair.second.get_chi_sq() /
+                               pair.second.get_ndf());
+    }
+  }
+  size_t reduced = primary_values.size();
+
+  std::cout << "Primary " << primary.get_tree_name() << ": "
+            << primary.event_column_data.size() << " sampled entries, "
+            << reduced << " reduced combos, chisq/ndf 10%/50%/90%: ";
+  print_quantiles(primary_values);
+  std::cout << '\n';
+
+  for (size_t i = 0; i < alts.size(); i++) {
+    std::vector<float> values;
+    if (config.best_by_beam) {
+      for (const auto& pair : c.matched_chi_sqs_by_beam[i]) {
+        values.push_back(pair.second);
+      }
+    } else {
+      for (const auto& pair : c.matched_chi_sqs[i]) {
+        values.push_back(pair.second);
+      }
+    }
+    std::cout << "  " << alts[i]->get_tree_name() << ": " << values.size()
+              << " matches, match rate " << std::fixed << std::setprecision(2)
+              << (reduced ? 100.0 * values.size() / reduced : 0.0) << '%'
+              << std::defaultfloat << std::setprecision(6);
+    // hashed samples are an unbiased fraction of the full dataset
+    if (sample.mode == Sample_mode::events ||
+        sample.mode == Sample_mode::runs) {
+      std::cout << ", ~" << static_cast<unsigned long long>(
+                                values.size() / sample.fraction)
+                << " expected in total";
+    }
+    std::cout << ", chisq/ndf 10%/50%/90%: ";
+    print_quantiles(values);
+    std::cout << '\n';
+  }
+
+  high_resolution_clock::time_point t2 = high_resolution_clock::now();
+  auto duration = duration_cast<microseconds>(t2 - t1).count();
+  std::cout << "The preview took: " << duration * 1E-6 << " seconds\n";
+  return 0;
+}
@@ -0,0 +1,11 @@
+#ifndef PREVIEW_H
+#define PREVIEW_H
+
+#include "job.h"
+
+// preview mode: loads only a deterministic sample of every tree, matches it
+// and reports per-hypothesis match rates and chisq/ndf quantiles. nothing is
+// written, so a new hypothesis can be checked in seconds.
+int run_preview_job(const Job_config& config);
+
+#endif
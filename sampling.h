@@ -0,0 +1,62 @@
+#ifndef SAMPLING_H
+#define SAMPLING_H
+
+#include <cstdint>
+#include <string>
+
+// deterministic input sampling for preview runs. the hash based modes select
+// the same run/event keys in every tree, so sampled matches stay valid.
+enum class Sample_mode {
+  none,
+  entries,  // the first sample_entries entries of each tree
+  events,   // a sample_fraction of events, selected by hashing run and event
+  runs      // a sample_fraction of runs, selected by hashing the run number
+};
+
+struct Sample_config {
+  Sample_mode mode = Sample_mode::none;
+  unsigned long long entries = 100000;
+  double fraction = 0.01;
+  unsigned long long seed = 0;
+};
+
+// splitmix64 step: adds the golden ratio increment and applies the
+// finalizer, which is a bijection on 64-bit keys
+inline std::uint64_t sample_mix(std::uint64_t z) {
+  z += 0x9e3779b97f4a7c15ULL;
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+// maps a hash to [0, 1)
+inline double sample_unit(std::uint64_t hash) {
+  return (hash >> 11) * (1.0 / 9007199254740992.0);
+}
+
+inline bool sample_run(const Sample_config& sample, unsigned int run) {
+  return sample_unit(sample_mix(run + sample.seed)) < sample.fraction;
+}
+
+// the run's hash is mixed again with the event, so every (run, event) pair
+// gets an independent hash whatever the width of either number
+inline bool sample_event(const Sample_config& sample, unsigned int run,
+                         unsigned long long event) {
+  return sample_unit(sample_mix(sample_mix(run + sample.seed) + event)) <
+         sample.fraction;
+}
+
+inline bool parse_sample_mode(const std::string& name, Sample_mode& mode) {
+  if (name == "entries") {
+    mode = Sample_mode::entries;
+  } else if (name == "events") {
+    mode = Sample_mode::events;
+  } else if (name == "runs") {
+    mode = Sample_mode::runs;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+#endif
@@ -0,0 +1,266 @@
+#include "streaming.h"
+
+#include <TBranch.h>
+#include <TChain.h>
+#include <TFile.h>
+#include <TTree.h>
+
+#include <iostream>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "input_files.h"
+
+namespace {
+
+struct Group_entry {
+  Long64_t entry;
+  unsigned int beam;
+  float chisq;
+  unsigned ndf;
+};
+
+// best combo per beam ID, or the single best combo under key 0
+using Reduced_group = std::map<unsigned int, Group_entry>;
+
+constexpr const char* KEY_BRANCHES[] = {"event", "run", "beam_beamid",
+                                        "kin_chisq", "kin_ndf"};
+
+// walks a chain sorted by (run, event) one event group at a time. only the
+// key branches are read while grouping, so the other branches of an entry
+// are read once, and only if the caller keeps it.
+class group_cursor {
+ public:
+  explicit group_cursor(TChain& chain)
+      : chain(chain), num_entries(chain.GetEntries()) {
+    chain.SetBranchAddress("event", &buffer.event);
+    chain.SetBranchAddress("run", &buffer.run);
+    chain.SetBranchAddress("beam_beamid", &buffer.beam);
+    chain.SetBranchAddress("kin_chisq", &buffer.chisq);
+    chain.SetBranchAddress("kin_ndf", &buffer.ndf);
+  }
+
+  // loads the next group of entries sharing run and event. returns false at
+  // the end of the chain or if the order is broken.
+  bool advance() {
+    group.clear();
+    if (next_entry >= num_entries) {
+      at_end = true;
+      return false;
+    }
+    read_keys(next_entry);
+    key = std::make_pair(buffer.run, buffer.event);
+    while (true) {
+      group.push_back({next_entry, buffer.beam, buffer.chisq, buffer.ndf});
+      if (++next_entry >= num_entries) {
+        break;
+      }
+      read_keys(next_entry);
+      std::pair<unsigned int, unsigned long long> next_key(buffer.run,
+                                                           buffer.event);
+      if (next_key == key) {
+        continue;
+      }
+      if (next_key < key) {
+        order_broken = true;
+        at_end = true;
+        return false;
+      }
+      break;
+    }
+    return true;
+  }
+
+  bool at_end = false;
+  bool order_broken = false;
+  std::pair<unsigned int, unsigned long long> key;
+  std::vector<Group_entry> group;
+
+ private:
+  void read_keys(Long64_t entry) {
+    Long64_t local = chain.LoadTree(entry);
+    if (chain.GetTreeNumber() != tree_number) {
+      tree_number = chain.GetTreeNumber();
+      key_branches.clear();
+      for (const char* name : KEY_BRANCHES) {
+        key_branches.push_back(chain.GetTree()->GetBranch(name));
+      }
+    }
+    for (TBranch* branch : key_branches) {
+      branch->GetEntry(local);
+    }
+  }
+
+  struct {
+    unsigned long long event;
+    unsigned int run;
+    unsigned int beam;
+    float chisq;
+    unsigned ndf;
+  } buffer;
+  TChain& chain;
+  Long64_t num_entries;
+  Long64_t next_entry = 0;
+  int tree_number = -1;
+  std::vector<TBranch*> key_branches;
+};
+
+// keeps the lowest chisq combo (the first one on ties, like the indexed
+// path) per beam ID, or overall
+Reduced_group reduce(const std::vector<Group_entry>& group, bool by_beam) {
+  Reduced_group best;
+  for (const Group_entry& entry : group) {
+    unsigned int slot = by_beam ? entry.beam : 0;
+    auto it = best.find(slot);
+    if (it == best.end() || entry.chisq < it->second.chisq) {
+      best[slot] = entry;
+    }
+  }
+  return best;
+}
+
+std::unique_ptr<TChain> make_chain(const std::string& glob,
+                                   const std::string& tree_name,
+                                   const Io_options& io) {
+  std::unique_ptr<TChain> chain(new TChain(tree_name.c_str()));
+  for (const std::string& file : expand_glob(glob)) {
+    chain->Add(file.c_str());
+  }
+  if (io.cache_size_mb > 0) {
+    chain->SetCacheSize(io.cache_size_mb * 1024 * 1024);
+  }
+  return chain;
+}
+
+}  // namespace
+
+Streaming_status run_streaming_job(const Job_config& config,
+                                   const std::string& out_file,
+                                   unsigned long long& matches) {
+  const bool by_beam = config.best_by_beam;
+  const size_t num_hypos = config.alt_hypos.size();
+  matches = 0;
+
+  // alternatives only need their key branches
+  std::vector<std::unique_ptr<TChain>> alt_chains;
+  std::vector<std::unique_ptr<group_cursor>> alts;
+  for (const Tree_config& alt : config.alt_hypos) {
+    alt_chains.push_back(make_chain(alt.filename, alt.treename, config.io));
+    alt_chains.back()->SetBranchStatus("*", false);
+    for (const char* branch : KEY_BRANCHES) {
+      alt_chains.back()->SetBranchStatus(branch, true);
+    }
+    alts.emplace_back(new group_cursor(*alt_chains.back()));
+    alts.back()->advance();
+  }
+
+  // the primary's kept entries are read in full once; the cursor's key
+  // buffers are bound before cloning so the output tree shares them
+  std::unique_ptr<TChain> primary_chain =
+      make_chain(config.primary.filename, config.primary.treename, config.io);
+  group_cursor primary(*primary_chain);
+
+  std::unique_ptr<TFile> file(TFile::Open(out_file.c_str(), "RECREATE"));
+  if (!file || file->IsZombie()) {
+    std::cerr << "Error: Could not open output file " << out_file << '\n';
+    return Streaming_status::failed;
+  }
+  TTree* out_tree = primary_chain->CloneTree(0);
+  out_tree->SetName("hypothesesMatched");
+  out_tree->SetTitle("hypothesesMatched");
+
+  // same branch layout as the compiled writer
+  std::vector<float> hypo_values(num_hypos);
+  unsigned int mask = 0;
+  for (size_t h = 0; h < num_hypos; h++) {
+    std::string name = config.alt_hypos[h].treename + "_chisq_ndf";
+    if (config.encoding.compact) {
+      std::string leaf = name + "/f[0,0," +
+                         std::to_string(config.encoding.mantissa_bits) + "]";
+      out_tree->Branch(name.c_str(), &hypo_values[h], leaf.c_str());
+    } else {
+      out_tree->Branch(name.c_str(), &hypo_values[h]);
+    }
+  }
+  if (config.encoding.compact) {
+    out_tree->Branch(MATCH_MASK_COLUMN, &mask);
+  }
+  Derived_values derived;
+  if (config.derived.best_hypothesis) {
+    out_tree->Branch(BEST_HYPOTHESIS_COLUMN, &derived.best_hypothesis);
+  }
+  if (config.derived.chisq_ndf_delta) {
+    out_tree->Branch(CHISQ_NDF_DELTA_COLUMN, &derived.chisq_ndf_delta);
+  }
+  if (config.derived.num_alt_matched) {
+    out_tree->Branch(NUM_ALT_MATCHED_COLUMN, &derived.num_alt_matched);
+  }
+
+  std::vector<Reduced_group> alt_best(num_hypos);
+  ROOT::RVec<float> values(num_hypos);
+  while (primary.advance()) {
+    Reduced_group best = reduce(primary.group, by_beam);
+
+    // move every alternative up to the primary's event
+    for (size_t h = 0; h < num_hypos; h++) {
+      group_cursor& alt = *alts[h];
+      while (!alt.at_end && alt.key < primary.key) {
+        alt.advance();
+      }
+      if (alt.order_broken) {
+        std::cout << "Tree " << config.alt_hypos[h].treename
+                  << " is not sorted by run and event.\n";
+        return Streaming_status::unsorted;
+      }
+      alt_best[h].clear();
+      if (!alt.at_end && alt.key == primary.key) {
+        alt_best[h] = reduce(alt.group, by_beam);
+        for (const auto& pair : best) {
+          matches += alt_best[h].count(pair.first);
+        }
+      }
+    }
+
+    for (const Group_entry& entry : primary.group) {
+      unsigned int slot = by_beam ? entry.beam : 0;
+      if (!config.preserve_combos &&
+          !compare_hypotheses::chi_sqs_equal(entry.chisq,
+                                             best.at(slot).chisq)) {
+        continue;
+      }
+      for (size_t h = 0; h < num_hypos; h++) {
+        auto it = alt_best[h].find(slot);
+        values[h] = it != alt_best[h].end()
+                        ? it->second.chisq / it->second.ndf
+                        : NO_MATCH_INDICATOR;
+        hypo_values[h] = encode_chisq_ndf(values[h], config.encoding);
+      }
+      mask = match_mask(values);
+      if (config.derived.any()) {
+        derived = compute_derived(entry.chisq, entry.ndf, values,
+                                  config.encoding);
+      }
+      // the cursor read only the key branches; read the whole entry once
+      primary_chain->GetEntry(entry.entry);
+      if (out_tree->Fill() < 0) {
+        std::cerr << "Error: Could not write output file " << out_file
+                  << '\n';
+        return Streaming_status::failed;
+      }
+    }
+  }
+  if (primary.order_broken) {
+    std::cout << "Tree " << config.primary.treename
+              << " is not sorted by run and event.\n";
+    return Streaming_status::unsorted;
+  }
+
+  if (file->Write() <= 0) {
+    std::cerr << "Error: Could not write output file " << out_file << '\n';
+    return Streaming_status::failed;
+  }
+  file->Close();
+  return Streaming_status::done;
+}
@@ -0,0 +1,28 @@
+#ifndef STREAMING_H
+#define STREAMING_H
+
+#include <string>
+
+#include "job.h"
+
+// streaming mode for inputs sorted by run and event (all combos of an event
+// in a row, as GlueX flat trees are written). every tree is read once, one
+// event at a time: each event's combos are reduced as they pass, alternative
+// trees are advanced in lockstep with the primary, and the output is written
+// in the same pass, so memory is bounded by the largest event.
+//
+// events are reduced and matched on (run, event) groups, so this mode needs
+// best_per_beam: the best overall combo mode reduces by event number alone,
+// across runs, which a single sorted pass cannot reproduce.
+enum class Streaming_status {
+  done,
+  unsorted,  // a tree is not sorted; the caller falls back to the indexed
+             // path, which overwrites the partial output
+  failed     // the output could not be written
+};
+
+Streaming_status run_streaming_job(const Job_config& config,
+                                   const std::string& out_file,
+                                   unsigned long long& matches);
+
+#endif
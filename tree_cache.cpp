@@ -0,0 +1,53 @@
+#include "tree_cache.h"
+
+#include <unistd.h>
+
+#include <climits>
+#include <iostream>
+
+std::shared_ptr<hypothesis_tree_base> tree_cache::get(
+    const std::string& file_glob, const std::string& tree_name,
+    bool match_type) {
+  std::string glob = file_glob;
+  char cwd[PATH_MAX];
+  if (!glob.empty() && glob[0] != '/' && getcwd(cwd, sizeof(cwd))) {
+    glob = std::string(cwd) + '/' + glob;
+  }
+  auto key = std::make_tuple(glob, tree_name, match_type);
+  std::vector<File_stamp> stamps = stamp_files(expand_glob(glob));
+
+  auto it = entries.find(key);
+  if (it != entries.end()) {
+    it->second.last_used = ++uses;
+    if (it->second.stamps == stamps) {
+      std::cout << "Reusing cached index for " << tree_name << '\n';
+      return it->second.tree;
+    }
+    std::cout << "Input files of " << tree_name
+              << " changed, rebuilding index\n";
+  }
+
+  entry& e = entries[key];
+  e.stamps = stamps;
+  e.tree = make_hypothesis_tree(glob, tree_name, match_type);
+  e.last_used = ++uses;
+  std::shared_ptr<hypothesis_tree_base> tree = e.tree;
+  evict();
+  return tree;
+}
+
+// drops least recently used trees until at most max_entries remain. trees
+// still held by a running job are freed once that job ends.
+void tree_cache::evict() {
+  while (entries.size() > max_entries) {
+    auto oldest = entries.begin();
+    for (auto it = entries.begin(); it != entries.end(); ++it) {
+      if (it->second.last_used < oldest->second.last_used) {
+        oldest = it;
+      }
+    }
+    std::cout << "Dropping cached index for " << std::get<1>(oldest->first)
+              << '\n';
+    entries.erase(oldest);
+  }
+}
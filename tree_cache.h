@@ -0,0 +1,42 @@
+#ifndef TREE_CACHE_H
+#define TREE_CACHE_H
+
+#include <map>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "compare_hypotheses.h"
+#include "input_files.h"
+
+// keeps prepared hypothesis trees in memory between jobs. an entry is rebuilt
+// whenever the set of files matched by its glob, or any file's size/mtime,
+// changes. relative globs are keyed by their absolute form, so jobs from
+// different working directories never share an entry by accident. beyond
+// max_entries trees, the least recently used ones are dropped.
+class tree_cache {
+ public:
+  explicit tree_cache(size_t max_entries = 16) : max_entries(max_entries) {}
+
+  std::shared_ptr<hypothesis_tree_base> get(const std::string& file_glob,
+                                            const std::string& tree_name,
+                                            bool match_type);
+
+  size_t size() const { return entries.size(); }
+  void clear() { entries.clear(); }
+
+ private:
+  struct entry {
+    std::vector<File_stamp> stamps;
+    std::shared_ptr<hypothesis_tree_base> tree;
+    unsigned long long last_used;
+  };
+  void evict();
+
+  size_t max_entries;
+  unsigned long long uses = 0;
+  std::map<std::tuple<std::string, std::string, bool>, entry> entries;
+};
+
+#endif